@@ -0,0 +1,332 @@
+/**
+ * @file benchmark.cpp
+ * @brief Display, refresh and button latency benchmarks with machine-readable output
+ * @version 0.1
+ *
+ *
+ */
+
+#include "benchmark.hpp"
+
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+
+#include <hd44780.h>
+#include <gesture.hpp>
+#include <lcd.hpp>
+#include <stopwatchengine.hpp>
+#include <cstring>
+
+#if defined(CONFIG_GPIO_EMUL) && defined(CONFIG_HD44780_VIRTUAL)
+#include <drivers/gpio/gpio_emul.h>
+#include <hd44780_virtual.h>
+#define BENCH_HAS_GLASS 1
+#endif
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+#include <hd44780_virtual.h>
+#endif
+
+const uint8_t BENCH_DISPLAY_BYTES = 64;
+const uint32_t BENCH_POLL_US = 100;
+const int32_t BENCH_GLASS_TIMEOUT_MS = 1000;
+const int32_t BENCH_FIRST_FRAME_TIMEOUT_MS = 5000;
+const int32_t BENCH_WINDOW_MS = 2000;   // frames sampled when there is no button to press
+const uint16_t BENCH_ENGINE_TICKS = 200;
+const uint8_t BENCH_ENGINE_SHOWN = 2;   // channels on the display, one per row
+
+struct bench_stat bench_isr = BENCH_STAT_INIT;
+struct bench_stat bench_frame_interval = BENCH_STAT_INIT;
+struct bench_stat bench_frame_render = BENCH_STAT_INIT;
+
+/* bench_isr is updated from the gpio callback */
+static struct k_spinlock bench_lock;
+
+
+/**
+ * @brief add one sample
+ *
+ * @param stat the statistic
+ * @param cycles the duration in hw cycles
+ */
+void bench_stat_add(struct bench_stat* stat, uint32_t cycles){
+    k_spinlock_key_t key = k_spin_lock(&bench_lock);
+
+    stat->count++;
+    stat->sum += cycles;
+    if(cycles < stat->min){
+        stat->min = cycles;
+    }
+    if(cycles > stat->max){
+        stat->max = cycles;
+    }
+
+    k_spin_unlock(&bench_lock, key);
+}
+
+/**
+ * @brief print a statistic as one BENCH line
+ *
+ * @param name name of the measurement, no spaces
+ * @param stat the statistic
+ */
+void bench_report(const char* name, const struct bench_stat* stat){
+    if(stat->count == 0){
+        printk("BENCH %s n=0\n", name);
+        return;
+    }
+
+    printk("BENCH %s n=%u mean_ns=%u min_ns=%u max_ns=%u\n", name, stat->count,
+           (uint32_t)k_cyc_to_ns_floor64(stat->sum / stat->count),
+           (uint32_t)k_cyc_to_ns_floor64(stat->min),
+           (uint32_t)k_cyc_to_ns_floor64(stat->max));
+}
+
+/**
+ * @brief cost of a blocking hd44780_data(), execution time of the previous byte included
+ *
+ * Runs on the display StopWatchLCD set up, with its queue flushed. Leaves digits in
+ * DDRAM and the address anywhere, the caller clears it.
+ */
+void bench_display_bytes(void){
+    struct bench_stat stat = BENCH_STAT_INIT;
+
+    hd44780_flush();
+    hd44780_pos(0, 0);
+    for(uint8_t i = 0; i < BENCH_DISPLAY_BYTES; i++){
+        uint32_t start = k_cycle_get_32();
+        hd44780_data('0' + i % 10);
+        bench_stat_add(&stat, k_cycle_get_32() - start);
+    }
+
+    bench_report("hd44780_data", &stat);
+}
+
+
+#ifdef BENCH_HAS_GLASS
+/**
+ * @brief drive the emulated sw0, the gpio callback runs from within this call
+ *
+ */
+static void bench_set_button(const struct gpio_dt_spec* sw0, bool pressed){
+    int level = (sw0->dt_flags & GPIO_ACTIVE_LOW) ? !pressed : pressed;
+
+    gpio_emul_input_set(sw0->port, sw0->pin, level);
+}
+
+/**
+ * @brief press sw0 and hold it
+ *
+ * @return uint32_t cycle stamp of the release edge
+ */
+static uint32_t bench_click(const struct gpio_dt_spec* sw0, int32_t hold_ms){
+    bench_set_button(sw0, true);
+    k_msleep(hold_ms);
+    uint32_t release = k_cycle_get_32();
+    bench_set_button(sw0, false);
+    return release;
+}
+
+/**
+ * @brief poll the virtual display until a row shows what is expected
+ *
+ * @param row row of the display
+ * @param contains text the row has to contain, or NULL
+ * @param differs_from the row has to differ from this, or NULL
+ * @param timeout_ms how long to poll
+ * @param seen receives the cycle stamp at which the row matched
+ * @return int 0 on a match, -ETIMEDOUT otherwise
+ */
+static int bench_wait_row(uint8_t row, const char* contains, const char* differs_from,
+                          int32_t timeout_ms, uint32_t* seen){
+    char glass[HD44780_VIRTUAL_COLS + 1];
+    int64_t deadline = k_uptime_get() + timeout_ms;
+
+    do{
+        hd44780_virtual_row(row, glass);
+        if((contains == NULL || strstr(glass, contains) != NULL) &&
+           (differs_from == NULL || strcmp(glass, differs_from) != 0)){
+            *seen = k_cycle_get_32();
+            return 0;
+        }
+        k_usleep(BENCH_POLL_US);
+    }while(k_uptime_get() < deadline);
+
+    return -ETIMEDOUT;
+}
+
+/**
+ * @brief time from a simulated release of sw0 until its effect is on the virtual display
+ *
+ * Starts the stopwatch and takes CONFIG_STOPWATCH_BENCHMARK_LAPS laps. The
+ * debounce time is part of the latency, as it is for a real button.
+ */
+static void bench_button_to_glass(const struct gpio_dt_spec* sw0){
+    struct bench_stat stat = BENCH_STAT_INIT;
+    char glass[HD44780_VIRTUAL_COLS + 1];
+    char before[HD44780_VIRTUAL_COLS + 1];
+    uint32_t release, seen;
+    uint32_t timeouts = 0;
+
+    bench_set_button(sw0, false);
+    memset(before, ' ', LCD_COLS);
+    before[LCD_COLS] = '\0';
+    if(bench_wait_row(0, NULL, before, BENCH_FIRST_FRAME_TIMEOUT_MS, &seen) != 0){
+        printk("BENCH button_to_glass skipped (display never drawn)\n");
+        return;
+    }
+
+    // a restored session comes back paused, get to a state a short press starts from
+    hd44780_virtual_row(0, glass);
+    if(strstr(glass, "PAUSED") != NULL){
+        bench_click(sw0, GESTURE_HOLD_INTERVAL + 100);
+        bench_wait_row(0, "RUNNING", NULL, BENCH_GLASS_TIMEOUT_MS, &seen);
+    }
+    hd44780_virtual_row(0, glass);
+    if(strstr(glass, "RUNNING") != NULL){
+        bench_click(sw0, 2 * GESTURE_HOLD_INTERVAL + 100);
+        bench_wait_row(0, "00:00:00", NULL, BENCH_GLASS_TIMEOUT_MS, &seen);
+    }
+
+    release = bench_click(sw0, 100);
+    if(bench_wait_row(0, "RUNNING", NULL, BENCH_GLASS_TIMEOUT_MS, &seen) == 0){
+        bench_stat_add(&stat, seen - release);
+    }else{
+        timeouts++;
+    }
+
+    for(uint32_t i = 0; i < CONFIG_STOPWATCH_BENCHMARK_LAPS; i++){
+        k_msleep(100 + 10 * i);     // every lap a different time, so every lap changes the glass
+        hd44780_virtual_row(1, before);
+        release = bench_click(sw0, 50);
+        if(bench_wait_row(1, "LAP", before, BENCH_GLASS_TIMEOUT_MS, &seen) == 0){
+            bench_stat_add(&stat, seen - release);
+        }else{
+            timeouts++;
+        }
+    }
+
+    bench_report("button_to_glass", &stat);
+    printk("BENCH button_to_glass_timeouts n=%u\n", timeouts);
+}
+#endif
+
+/* one engine per size, static so hundreds of channels stay off the stack */
+static StopwatchEngine<1> bench_engine_1;
+static StopwatchEngine<16> bench_engine_16;
+static StopwatchEngine<64> bench_engine_64;
+static StopwatchEngine<256> bench_engine_256;
+
+/**
+ * @brief cost of one display tick of a stopwatch engine with N running channels
+ *
+ * engine_tick is what a frame pays: moving the time base and formatting the
+ * BENCH_ENGINE_SHOWN channels on the display, it should not grow with N.
+ * engine_sweep reads the time of every channel, what a frame would pay with
+ * one stopwatch object per channel. engine_lap is one lap on one channel.
+ */
+template<uint16_t N>
+static void bench_engine(StopwatchEngine<N>& engine){
+    struct bench_stat tick = BENCH_STAT_INIT;
+    struct bench_stat sweep = BENCH_STAT_INIT;
+    struct bench_stat lap = BENCH_STAT_INIT;
+    uint16_t shown[BENCH_ENGINE_SHOWN];
+    char rows[BENCH_ENGINE_SHOWN][TIMEFMT_LEN];
+    char name[32];
+    int64_t now = k_uptime_ticks();
+    volatile int64_t sink = 0;
+
+    for(uint16_t ch = 0; ch < N; ch++){
+        engine.start(ch, now - ch);
+    }
+    for(uint8_t i = 0; i < BENCH_ENGINE_SHOWN; i++){
+        shown[i] = (i == 0) ? 0 : N - 1;
+    }
+
+    for(uint16_t i = 0; i < BENCH_ENGINE_TICKS; i++){
+        now += k_ms_to_ticks_ceil64(LCD_UPDATE_PERIOD);
+
+        uint32_t start = k_cycle_get_32();
+        engine.tick(now);
+        engine.render(shown, BENCH_ENGINE_SHOWN, rows);
+        bench_stat_add(&tick, k_cycle_get_32() - start);
+
+        start = k_cycle_get_32();
+        for(uint16_t ch = 0; ch < N; ch++){
+            sink += engine.elapsed(ch);
+        }
+        bench_stat_add(&sweep, k_cycle_get_32() - start);
+
+        start = k_cycle_get_32();
+        sink += engine.lap(i % N, now);
+        bench_stat_add(&lap, k_cycle_get_32() - start);
+    }
+
+    snprintk(name, sizeof(name), "engine_tick_n%u", N);
+    bench_report(name, &tick);
+    snprintk(name, sizeof(name), "engine_sweep_n%u", N);
+    bench_report(name, &sweep);
+    snprintk(name, sizeof(name), "engine_lap_n%u", N);
+    bench_report(name, &lap);
+}
+
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+/**
+ * @brief I2C traffic of the backpack displays per frame over a window
+ *
+ * @param start emulator counters at the start of the window
+ * @param frames frames drawn in the window
+ */
+static void bench_i2c_report(const struct hd44780_virtual_i2c* start, uint32_t frames){
+    struct hd44780_virtual_i2c end;
+
+    hd44780_virtual_i2c_stats(&end);
+    if(frames == 0){
+        printk("BENCH i2c_per_frame n=0\n");
+        return;
+    }
+
+    uint32_t transactions = end.transactions - start->transactions;
+    uint32_t bytes = end.bytes - start->bytes;
+    // hundredths, printk has no floats
+    uint32_t per_frame = transactions * 100 / frames;
+
+    printk("BENCH i2c_per_frame n=%u transactions=%u.%02u bytes=%u\n", frames,
+           per_frame / 100, per_frame % 100, bytes / frames);
+}
+#endif
+
+/**
+ * @brief run the benchmarks that need the threads, then print everything collected
+ *
+ * @param sw0 the button, pressed through the GPIO emulator if there is one
+ */
+void bench_run(const struct gpio_dt_spec* sw0){
+    bench_engine(bench_engine_1);
+    bench_engine(bench_engine_16);
+    bench_engine(bench_engine_64);
+    bench_engine(bench_engine_256);
+
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+    struct hd44780_virtual_i2c i2c_start;
+    uint32_t frames_start = bench_frame_interval.count;
+
+    hd44780_virtual_i2c_stats(&i2c_start);
+#endif
+
+#ifdef BENCH_HAS_GLASS
+    bench_button_to_glass(sw0);
+#else
+    printk("BENCH button_to_glass skipped (needs GPIO_EMUL and HD44780_VIRTUAL)\n");
+    k_msleep(BENCH_WINDOW_MS);
+#endif
+
+    bench_report("gpio_isr", &bench_isr);
+    bench_report("lcd_frame_interval", &bench_frame_interval);
+    printk("BENCH lcd_frame_target ns=%u\n", CONFIG_STOPWATCH_RUN_REFRESH_CENTIS * 10000000u);
+    bench_report("lcd_frame_render", &bench_frame_render);
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+    bench_i2c_report(&i2c_start, bench_frame_interval.count - frames_start);
+#endif
+    printk("BENCH done\n");
+}
+
+#endif // CONFIG_STOPWATCH_BENCHMARK
@@ -0,0 +1,42 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <zephyr.h>
+#include <drivers/gpio.h>
+
+/**
+ * @brief count, sum, min and max of a duration in hw cycles
+ *
+ */
+struct bench_stat{
+    uint32_t count;
+    uint64_t sum;
+    uint32_t min;
+    uint32_t max;
+};
+
+/* an empty bench_stat, min starts high so the first sample sets it */
+#define BENCH_STAT_INIT {0, 0, UINT32_MAX, 0}
+
+/*
+ * In-app benchmarks, enabled with CONFIG_STOPWATCH_BENCHMARK.
+ *
+ * Every result is printed as one line
+ *   BENCH <name> n=<count> mean_ns=<ns> min_ns=<ns> max_ns=<ns>
+ * so runs of two commits can be diffed or parsed with a script. The button
+ * to glass latency needs sw0 on emulated GPIO and the virtual HD44780, which
+ * the native_posix build provides, and is reported as skipped elsewhere.
+ */
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+extern struct bench_stat bench_isr;
+extern struct bench_stat bench_frame_interval;
+extern struct bench_stat bench_frame_render;
+
+void bench_stat_add(struct bench_stat* stat, uint32_t cycles);
+void bench_report(const char* name, const struct bench_stat* stat);
+void bench_display_bytes(void);
+void bench_run(const struct gpio_dt_spec* sw0);
+#endif
+
+
+#endif /*BENCHMARK_H*/
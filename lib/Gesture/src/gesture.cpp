@@ -0,0 +1,107 @@
+/**
+ * @file gesture.cpp
+ * @brief Debounced press-gesture classifier for the stopwatch button
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include "gesture.hpp"
+#include "gesturechannel.hpp"
+
+
+/**
+ * @brief set up the timers. The gpio callback of the button has to call on_edge()
+ * 
+ * @param button the button, read once the debounce time has passed
+ * @param channel channel the events are published to
+ */
+void GestureClassifier::init(const struct gpio_dt_spec* button, GestureChannel* channel){
+    this->button = button;
+    this->channel = channel;
+
+    k_timer_init(&debounce_timer, debounce_expired, NULL);
+    k_timer_user_data_set(&debounce_timer, this);
+    k_timer_init(&hold_timer, hold_expired, NULL);
+    k_timer_user_data_set(&hold_timer, this);
+}
+
+/**
+ * @brief called from the gpio callback on both edges of the button
+ * 
+ * Only (re)starts the debounce timer, the pin is read once it has settled.
+ */
+void GestureClassifier::on_edge(void){
+    if(!edge_pending){
+        edge_pending = true;
+        edge_timestamp = k_uptime_ticks();
+    }
+    k_timer_start(&debounce_timer, K_MSEC(CONFIG_STOPWATCH_DEBOUNCE_MS), K_NO_WAIT);
+}
+
+/**
+ * @brief debounce_timer expiry function, the button has been stable for the debounce time
+ * 
+ * @param timer the debounce timer, user data is the classifier
+ */
+void GestureClassifier::debounce_expired(struct k_timer* timer){
+    GestureClassifier* self = (GestureClassifier*)k_timer_user_data_get(timer);
+    bool level = gpio_pin_get_dt(self->button) > 0;
+
+    self->edge_pending = false;
+
+    if(level == self->pressed){ //bounced back to where it was
+        self->bounces_filtered++;
+        return;
+    }
+    self->pressed = level;
+
+    if(level){
+        self->holds = 0;
+        self->press_timestamp = self->edge_timestamp;
+        // holds count from the edge, not from the end of the debounce
+        k_timer_start(&self->hold_timer,
+                      K_TIMEOUT_ABS_TICKS(self->press_timestamp + k_ms_to_ticks_ceil64(GESTURE_HOLD_INTERVAL)),
+                      K_MSEC(GESTURE_HOLD_INTERVAL));
+        self->emit(GESTURE_PRESS, self->edge_timestamp);
+        return;
+    }
+
+    k_timer_stop(&self->hold_timer);
+    if(self->holds == 0){
+        self->emit(GESTURE_RELEASE_SHORT, self->edge_timestamp);
+    }else if(self->holds == 1){
+        self->emit(GESTURE_RELEASE_LONG, self->edge_timestamp);
+    }else{
+        self->emit(GESTURE_RELEASE_VERY_LONG, self->edge_timestamp);
+    }
+}
+
+/**
+ * @brief hold_timer expiry function, fires at 2 s and 4 s of holding
+ * 
+ * @param timer the hold timer, user data is the classifier
+ */
+void GestureClassifier::hold_expired(struct k_timer* timer){
+    GestureClassifier* self = (GestureClassifier*)k_timer_user_data_get(timer);
+
+    self->holds++;
+    if(self->holds == 1){
+        self->emit(GESTURE_HOLD_2S, k_uptime_ticks());
+    }else{
+        k_timer_stop(timer);
+        self->emit(GESTURE_HOLD_4S, k_uptime_ticks());
+    }
+}
+
+/**
+ * @brief publish an event, once for all subscribers
+ * 
+ * @param type gesture_type
+ * @param timestamp uptime in ticks of the edge or hold expiry
+ */
+void GestureClassifier::emit(uint8_t type, int64_t timestamp){
+    struct gesture_event event = {type, timestamp, this->press_timestamp, k_cycle_get_32(), GESTURE_SOURCE_BUTTON, 0};
+
+    this->channel->publish(event);
+}
@@ -0,0 +1,82 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <zephyr.h>
+#include <drivers/gpio.h>
+
+/**
+ * @brief semantic button and key events, each emitted once per press
+ * 
+ */
+enum gesture_type{
+    GESTURE_PRESS = 0,
+    GESTURE_HOLD_2S,            // still held after 2 s
+    GESTURE_HOLD_4S,            // still held after 4 s
+    GESTURE_RELEASE_SHORT,      // released before 2 s
+    GESTURE_RELEASE_LONG,       // released between 2 and 4 s
+    GESTURE_RELEASE_VERY_LONG,  // released after at least 4 s
+    GESTURE_KEY_START,          // keypad or remote: start, or resume when paused
+    GESTURE_KEY_LAP,            // keypad or remote: lap
+    GESTURE_KEY_PAUSE,          // keypad or remote: pause
+    GESTURE_KEY_RESET,          // keypad or remote: reset
+    GESTURE_NUM_TYPES
+};
+
+/**
+ * @brief where a gesture came from
+ * 
+ */
+enum gesture_source{
+    GESTURE_SOURCE_BUTTON = 0,  // sw0 through the GestureClassifier
+    GESTURE_SOURCE_KEYPAD,
+    GESTURE_SOURCE_REMOTE,      // a command on the remote UART
+};
+
+struct gesture_event{
+    uint8_t type;
+    int64_t timestamp;          // k_uptime_ticks() of the (first, undebounced) edge or hold expiry, taken in the ISR
+    int64_t press_timestamp;    // k_uptime_ticks() of the edge that started this press
+    uint32_t queued;            // k_cycle_get_32() when it was published, for remote commands when the byte arrived
+    uint8_t source;             // gesture_source
+    uint8_t channel;            // stopwatch channel it is for, 0 (the display's) unless a remote command picked one
+};
+
+const uint16_t GESTURE_HOLD_INTERVAL = 2000;   //ms (2 sec)
+
+class GestureChannel;
+
+
+/**
+ * @brief turns the raw edges of a button into debounced gesture events
+ * 
+ * Fed from the gpio callback with on_edge(). An edge is accepted once the pin 
+ * has been stable for CONFIG_STOPWATCH_DEBOUNCE_MS, and keeps the timestamp of 
+ * the first edge of the bounce. One hold timer classifies the press, and every 
+ * event is published once to a GestureChannel.
+ * 
+ */
+class GestureClassifier{
+    public:
+        void init(const struct gpio_dt_spec* button, GestureChannel* channel);
+        void on_edge(void);
+
+        uint32_t bounces_filtered = 0;
+
+    private:
+        static void debounce_expired(struct k_timer* timer);
+        static void hold_expired(struct k_timer* timer);
+        void emit(uint8_t type, int64_t timestamp);
+
+        const struct gpio_dt_spec* button;
+        struct k_timer debounce_timer;
+        struct k_timer hold_timer;
+        GestureChannel* channel;
+        bool pressed = false;
+        bool edge_pending = false;
+        uint8_t holds = 0;
+        int64_t edge_timestamp = 0;
+        int64_t press_timestamp = 0;
+};
+
+
+#endif /*GESTURE_H*/
@@ -0,0 +1,115 @@
+/**
+ * @file gesturechannel.cpp
+ * @brief Multiple producer, multiple subscriber ring for gesture events
+ * @version 0.1
+ *
+ *
+ */
+
+#include "gesturechannel.hpp"
+
+BUILD_ASSERT((CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE & (CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE - 1)) == 0,
+             "CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE must be a power of two");
+
+#define SLOT_MASK (CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE - 1)
+
+
+/**
+ * @brief add a subscriber, it gets every event published from now on
+ *
+ * @param subscriber the subscriber, has to outlive the channel
+ * @param queue workqueue of @p work, or NULL
+ * @param work submitted to @p queue on publish instead of giving the semaphore, or NULL
+ * @return int 0 on success, -ENOMEM if there are already GESTURE_MAX_SUBSCRIBERS
+ *
+ * The list is not locked, subscribe from one thread only. publish() may already
+ * be running, the entry is filled in before it is counted.
+ */
+int GestureChannel::subscribe(struct gesture_subscriber* subscriber, struct k_work_q* queue, struct k_work* work){
+    if(this->num_subscribers >= GESTURE_MAX_SUBSCRIBERS){
+        return -ENOMEM;
+    }
+
+    k_sem_init(&subscriber->available, 0, 1);
+    subscriber->next = (uint32_t)atomic_get(&this->head);
+    subscriber->dropped = 0;
+    subscriber->queue = queue;
+    subscriber->work = work;
+    this->subscribers[this->num_subscribers] = subscriber;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    this->num_subscribers++;
+    return 0;
+}
+
+/**
+ * @brief publish an event to every subscriber, callable from an ISR
+ *
+ * @param event the event
+ */
+void GestureChannel::publish(const struct gesture_event& event){
+    k_spinlock_key_t key = k_spin_lock(&this->publish_lock);
+    uint32_t seq = (uint32_t)atomic_get(&this->head);
+    struct slot* slot = &this->slots[seq & SLOT_MASK];
+
+    // a reader still copying the old event sees the new sequence number and retries
+    atomic_set(&slot->seq, (atomic_val_t)seq);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    slot->event = event;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    atomic_set(&this->head, (atomic_val_t)(seq + 1));
+    k_spin_unlock(&this->publish_lock, key);
+
+    this->notify();
+}
+
+/**
+ * @brief take the next event of a subscriber
+ *
+ * @param subscriber the subscriber, only read from one thread
+ * @param event receives the event
+ * @return int 0 if there was an event, -EAGAIN if the subscriber is up to date
+ */
+int GestureChannel::read(struct gesture_subscriber* subscriber, struct gesture_event* event){
+    while(true){
+        uint32_t head = (uint32_t)atomic_get(&this->head);
+
+        if(subscriber->next == head){
+            return -EAGAIN;
+        }
+        if(head - subscriber->next > CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE){
+            subscriber->dropped += head - subscriber->next - CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE;
+            subscriber->next = head - CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE;
+        }
+
+        const struct slot* slot = &this->slots[subscriber->next & SLOT_MASK];
+        *event = slot->event;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if((uint32_t)atomic_get(&slot->seq) == subscriber->next){
+            subscriber->next++;
+            return 0;
+        }
+        // overwritten while copying, the head has moved on past it
+    }
+}
+
+/**
+ * @brief wake every subscriber, from the context of the publisher
+ *
+ * k_sem_give() and k_work_submit_to_queue() are ISR-safe, so the subscribers are
+ * woken right away and never wait behind other work on the system workqueue,
+ * like the lap log's flash writes.
+ */
+void GestureChannel::notify(void){
+    uint8_t count = this->num_subscribers;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for(uint8_t i = 0; i < count; i++){
+        struct gesture_subscriber* subscriber = this->subscribers[i];
+
+        if(subscriber->work != NULL){
+            k_work_submit_to_queue(subscriber->queue, subscriber->work);
+        }else{
+            k_sem_give(&subscriber->available);
+        }
+    }
+}
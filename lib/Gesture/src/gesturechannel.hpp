@@ -0,0 +1,58 @@
+#ifndef GESTURECHANNEL_H
+#define GESTURECHANNEL_H
+
+#include <zephyr.h>
+#include "gesture.hpp"
+
+const uint8_t GESTURE_MAX_SUBSCRIBERS = 4;
+
+/**
+ * @brief one reader of a GestureChannel, with its own read position
+ *
+ */
+struct gesture_subscriber{
+    struct k_sem available;     // given when events were published, k_poll it with K_POLL_TYPE_SEM_AVAILABLE
+    uint32_t next;              // sequence number of the next event to read
+    uint32_t dropped;           // events overwritten before this subscriber got to them
+    struct k_work_q* queue;     // if work is set, it is submitted to this queue instead of giving available
+    struct k_work* work;
+};
+
+/**
+ * @brief fan-out channel for gesture events
+ *
+ * The classifier publishes each event once into a ring of sequence numbered
+ * slots, every subscriber reads all of them at its own pace. A subscriber that
+ * falls more than CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE events behind loses the
+ * oldest ones and counts them in its dropped counter.
+ *
+ * publish() writes the slot and then gives the semaphore of every subscriber, or
+ * submits its work item if it runs on a workqueue, both ISR-safe. Nothing sits
+ * between the publisher and the subscribers, so a busy system workqueue can't
+ * hold up an event.
+ * Publishers are serialised with a spinlock, so the button and the keypad can
+ * both publish from their ISRs.
+ */
+class GestureChannel{
+    public:
+        int subscribe(struct gesture_subscriber* subscriber, struct k_work_q* queue = NULL, struct k_work* work = NULL);
+        void publish(const struct gesture_event& event);
+        int read(struct gesture_subscriber* subscriber, struct gesture_event* event);
+
+    private:
+        void notify(void);
+
+        struct slot{
+            atomic_t seq;       // sequence number of the event in the slot, set before it is written
+            struct gesture_event event;
+        };
+
+        struct slot slots[CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE];
+        atomic_t head = 0;      // sequence number of the next event to publish
+        struct k_spinlock publish_lock;
+        struct gesture_subscriber* subscribers[GESTURE_MAX_SUBSCRIBERS];
+        uint8_t num_subscribers = 0;
+};
+
+
+#endif /*GESTURECHANNEL_H*/
@@ -0,0 +1,213 @@
+/**
+ * @file keypad.cpp
+ * @brief ADC sampled keypad of the DFR0009 on A0, decoded and debounced in the sampling callback
+ * @version 0.1
+ *
+ *
+ */
+
+#include "keypad.hpp"
+
+#ifdef CONFIG_STOPWATCH_KEYPAD
+
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/adc.h>
+
+#define KEYPAD_NODE DT_PATH(zephyr_user)
+#define KEYPAD_RESOLUTION 12
+
+/**
+ * @brief upper end of the voltage range of a key
+ *
+ */
+struct keypad_threshold{
+    int32_t below_mv;
+    uint8_t key;
+};
+
+/* The keys pull A0 to 0, 0.71, 1.61, 2.47 and 3.62 V of the 5 V ladder, released is 5 V.
+ * Each range ends halfway to the next key. */
+static const struct keypad_threshold thresholds[] = {
+    {355, KEYPAD_RIGHT},
+    {1160, KEYPAD_UP},
+    {2040, KEYPAD_DOWN},
+    {3045, KEYPAD_LEFT},
+    {4310, KEYPAD_SELECT},
+};
+
+static const struct device* adc_dev = DEVICE_DT_GET(DT_IO_CHANNELS_CTLR(KEYPAD_NODE));
+static const uint8_t adc_channel = DT_IO_CHANNELS_INPUT(KEYPAD_NODE);
+
+/* only touched by the sampling callback once the read is started */
+static struct{
+    GestureChannel* channel;
+    int16_t sample;
+    uint8_t key;                // debounced key
+    uint8_t candidate;          // key of the last samples
+    uint8_t agreeing;           // samples in a row that decoded to candidate
+    int64_t candidate_timestamp;
+    struct adc_sequence_options options;
+    struct adc_sequence sequence;
+    struct k_poll_signal done;
+} keypad;
+
+
+/**
+ * @brief the key a voltage on A0 stands for
+ *
+ * @param mv the voltage in mV
+ * @return uint8_t keypad_key
+ */
+static uint8_t keypad_decode(int32_t mv){
+    for(uint8_t i = 0; i < ARRAY_SIZE(thresholds); i++){
+        if(mv < thresholds[i].below_mv){
+            return thresholds[i].key;
+        }
+    }
+    return KEYPAD_NONE;
+}
+
+/**
+ * @brief the gesture a key press is published as
+ *
+ * @param key keypad_key
+ * @return uint8_t gesture_type, GESTURE_NUM_TYPES for keys without a function
+ */
+static uint8_t keypad_gesture(uint8_t key){
+    switch(key){
+    case KEYPAD_RIGHT:
+        return GESTURE_KEY_START;
+    case KEYPAD_UP:
+        return GESTURE_KEY_LAP;
+    case KEYPAD_DOWN:
+        return GESTURE_KEY_PAUSE;
+    case KEYPAD_LEFT:
+        return GESTURE_KEY_RESET;
+    default:
+        return GESTURE_NUM_TYPES;
+    }
+}
+
+/**
+ * @brief sampling callback, called from the ADC driver after every sample
+ *
+ * @return enum adc_action always ADC_ACTION_REPEAT, the read never ends
+ */
+static enum adc_action keypad_sampled(const struct device* dev, const struct adc_sequence* sequence,
+                                      uint16_t sampling_index){
+    int32_t mv = keypad.sample;
+
+    adc_raw_to_millivolts(adc_ref_internal(dev), ADC_GAIN_1, KEYPAD_RESOLUTION, &mv);
+    uint8_t key = keypad_decode(mv);
+
+    if(key != keypad.candidate){
+        keypad.candidate = key;
+        keypad.agreeing = 1;
+        keypad.candidate_timestamp = k_uptime_ticks();
+    }else if(keypad.agreeing < CONFIG_STOPWATCH_KEYPAD_DEBOUNCE_SAMPLES){
+        keypad.agreeing++;
+    }
+
+    if(keypad.agreeing >= CONFIG_STOPWATCH_KEYPAD_DEBOUNCE_SAMPLES && key != keypad.key){
+        keypad.key = key;
+        uint8_t gesture = keypad_gesture(key);
+        if(gesture < GESTURE_NUM_TYPES){
+            struct gesture_event event = {gesture, keypad.candidate_timestamp, keypad.candidate_timestamp,
+                                          k_cycle_get_32(), GESTURE_SOURCE_KEYPAD, 0};
+            keypad.channel->publish(event);
+        }
+    }
+
+    return ADC_ACTION_REPEAT;
+}
+
+/**
+ * @brief set up the ADC channel and start sampling
+ *
+ * @param channel channel the key gestures are published to
+ * @return int 0 on success, negative errno otherwise
+ */
+int keypad_init(GestureChannel* channel){
+    struct adc_channel_cfg cfg = {};
+    int rc;
+
+    if(!device_is_ready(adc_dev)){
+        return -ENODEV;
+    }
+
+    cfg.gain = ADC_GAIN_1;
+    cfg.reference = ADC_REF_INTERNAL;
+    cfg.acquisition_time = ADC_ACQ_TIME_DEFAULT;
+    cfg.channel_id = adc_channel;
+    rc = adc_channel_setup(adc_dev, &cfg);
+    if(rc != 0){
+        printk("Keypad: channel setup failed: %d\n", rc);
+        return rc;
+    }
+
+    keypad.channel = channel;
+    keypad.key = keypad.candidate = KEYPAD_NONE;
+    keypad.agreeing = 0;
+
+    keypad.options.interval_us = CONFIG_STOPWATCH_KEYPAD_SAMPLE_INTERVAL_US;
+    keypad.options.callback = keypad_sampled;
+    keypad.options.extra_samplings = 0;
+
+    keypad.sequence.options = &keypad.options;
+    keypad.sequence.channels = BIT(adc_channel);
+    keypad.sequence.buffer = &keypad.sample;
+    keypad.sequence.buffer_size = sizeof(keypad.sample);
+    keypad.sequence.resolution = KEYPAD_RESOLUTION;
+
+    // never raised, the callback keeps the read going
+    k_poll_signal_init(&keypad.done);
+    rc = adc_read_async(adc_dev, &keypad.sequence, &keypad.done);
+    if(rc != 0){
+        printk("Keypad: starting the read failed: %d\n", rc);
+    }
+    return rc;
+}
+
+/**
+ * @brief the debounced key that is down right now
+ *
+ * @return uint8_t keypad_key
+ */
+uint8_t keypad_current(void){
+    return keypad.key;
+}
+
+
+#if defined(CONFIG_ADC_EMUL) && defined(CONFIG_SHELL)
+#include <drivers/adc/adc_emul.h>
+#include <shell/shell.h>
+#include <string.h>
+
+/* voltage of every keypad_key for the emulator, see thresholds */
+static const uint32_t key_mv[KEYPAD_NUM_KEYS] = {5000, 0, 710, 1610, 2470, 3620};
+static const char* const key_names[KEYPAD_NUM_KEYS] = {"none", "right", "up", "down", "left", "select"};
+
+/**
+ * @brief "keypad set <key>": put the voltage of a key on the emulated A0
+ *
+ */
+static int cmd_keypad_set(const struct shell* sh, size_t argc, char** argv){
+    for(uint8_t i = 0; i < KEYPAD_NUM_KEYS; i++){
+        if(strcmp(argv[1], key_names[i]) == 0){
+            return adc_emul_const_value_set(adc_dev, adc_channel, key_mv[i]);
+        }
+    }
+    shell_error(sh, "keys: none right up down left select");
+    return -EINVAL;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_keypad,
+    SHELL_CMD_ARG(set, NULL, "Hold a key on the emulated keypad (none to release)", cmd_keypad_set, 2, 0),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(keypad, &sub_keypad, "Emulated DFR0009 keypad", NULL);
+#endif
+
+#endif // CONFIG_STOPWATCH_KEYPAD
@@ -0,0 +1,42 @@
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <zephyr.h>
+#include <gesturechannel.hpp>
+
+/**
+ * @brief the five keys of the DFR0009, all on one resistor ladder read through A0
+ *
+ */
+enum keypad_key{
+    KEYPAD_NONE = 0,
+    KEYPAD_RIGHT,       // start / resume
+    KEYPAD_UP,          // lap
+    KEYPAD_DOWN,        // pause
+    KEYPAD_LEFT,        // reset
+    KEYPAD_SELECT,      // unused
+    KEYPAD_NUM_KEYS
+};
+
+/*
+ * Keypad on the ADC channel in the io-channels of the zephyr,user node.
+ *
+ * The channel is sampled every CONFIG_STOPWATCH_KEYPAD_SAMPLE_INTERVAL_US by
+ * one never ending async read, whose sampling callback decodes the voltage
+ * into a key. A key counts once CONFIG_STOPWATCH_KEYPAD_DEBOUNCE_SAMPLES
+ * samples in a row agree, its gesture (GESTURE_KEY_*) is published on the
+ * press with the timestamp of the first of those samples. There is no thread.
+ *
+ * The ladder hangs off the shield's 5 V. On a 3.3 V ADC SELECT reads like no
+ * key, which is why it has no function.
+ */
+#ifdef CONFIG_STOPWATCH_KEYPAD
+int keypad_init(GestureChannel* channel);
+uint8_t keypad_current(void);
+#else
+static inline int keypad_init(GestureChannel* channel) {return -ENOTSUP;}
+static inline uint8_t keypad_current(void) {return KEYPAD_NONE;}
+#endif
+
+
+#endif /*KEYPAD_H*/
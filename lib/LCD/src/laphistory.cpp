@@ -0,0 +1,80 @@
+/**
+ * @file laphistory.cpp
+ * @brief Fixed capacity lap history with running statistics
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include "laphistory.hpp"
+
+
+/**
+ * @brief forget every lap and the statistics, for a new session
+ * 
+ */
+void LapHistory::clear(void){
+    this->num_laps = 0;
+    this->best_lap = this->worst_lap = 0;
+    this->mean_lap = this->m2 = 0;
+}
+
+/**
+ * @brief record a lap, overwriting the oldest one when the history is full
+ * 
+ * @param duration duration of the lap in ticks
+ * @return const struct lap_record& the stored lap
+ */
+const struct lap_record& LapHistory::add(int64_t duration){
+    struct lap_record& lap = this->laps[this->num_laps % CONFIG_STOPWATCH_LAP_HISTORY_SIZE];
+
+    lap.number = this->num_laps + 1;
+    lap.duration = duration;
+
+    if(this->num_laps == 0){
+        lap.delta_best = 0;
+        this->best_lap = this->worst_lap = duration;
+    }else{
+        lap.delta_best = duration - this->best_lap;
+        if(duration < this->best_lap){
+            this->best_lap = duration;
+        }
+        if(duration > this->worst_lap){
+            this->worst_lap = duration;
+        }
+    }
+
+    this->num_laps++;
+
+    // Welford's online mean and variance
+    double delta = (double)duration - this->mean_lap;
+    this->mean_lap += delta / this->num_laps;
+    this->m2 += delta * ((double)duration - this->mean_lap);
+
+    return lap;
+}
+
+/**
+ * @brief a stored lap
+ * 
+ * @param age 0 for the most recent lap, 1 for the one before, ...
+ * @return const struct lap_record* the lap, NULL if it is no longer (or not yet) stored
+ */
+const struct lap_record* LapHistory::get(uint32_t age) const {
+    if(age >= this->stored()){
+        return NULL;
+    }
+    return &this->laps[(this->num_laps - 1 - age) % CONFIG_STOPWATCH_LAP_HISTORY_SIZE];
+}
+
+/**
+ * @brief sample variance of all laps of the session
+ * 
+ * @return int64_t variance in ticks^2, 0 with fewer than two laps
+ */
+int64_t LapHistory::variance(void) const {
+    if(this->num_laps < 2){
+        return 0;
+    }
+    return (int64_t)(this->m2 / (this->num_laps - 1));
+}
@@ -0,0 +1,47 @@
+#ifndef LAPHISTORY_H
+#define LAPHISTORY_H
+
+#include <zephyr.h>
+
+/**
+ * @brief one recorded lap
+ * 
+ */
+struct lap_record{
+    uint32_t number;        // 1 for the first lap of a session
+    int64_t duration;       // ticks
+    int64_t delta_best;     // ticks, duration minus the best lap before this one (0 for the first lap)
+};
+
+/**
+ * @brief statically allocated history of the last CONFIG_STOPWATCH_LAP_HISTORY_SIZE laps
+ * 
+ * Best/worst/mean/variance cover every lap of the session, not only the ones 
+ * still in the ring, and are updated on insert (Welford) so they cost O(1) per lap.
+ * 
+ */
+class LapHistory{
+    public:
+        void clear(void);
+        const struct lap_record& add(int64_t duration);
+        const struct lap_record* get(uint32_t age) const;
+
+        uint32_t count(void) const {return this->num_laps;}
+        uint32_t stored(void) const {return (this->num_laps < CONFIG_STOPWATCH_LAP_HISTORY_SIZE) ? this->num_laps : CONFIG_STOPWATCH_LAP_HISTORY_SIZE;}
+        int64_t best(void) const {return this->best_lap;}
+        int64_t worst(void) const {return this->worst_lap;}
+        int64_t mean(void) const {return (int64_t)this->mean_lap;}
+        int64_t variance(void) const;
+
+    private:
+        struct lap_record laps[CONFIG_STOPWATCH_LAP_HISTORY_SIZE];
+        uint32_t num_laps = 0;
+        int64_t best_lap = 0;
+        int64_t worst_lap = 0;
+        /* running mean and sum of squared differences from it, in ticks */
+        double mean_lap = 0;
+        double m2 = 0;
+};
+
+
+#endif /*LAPHISTORY_H*/
@@ -9,39 +9,90 @@
  */
 
 #include "lcd.hpp"
+#include <cstring>
+#include <new>
+
+/* kept out of StopWatchLCD so its size doesn't land on the thread stack */
+static LapHistory lap_history;
+static SwEngine engine;
+
+/* "MM:SS:cc RUNNING" and "Press to restart" are the longest rows, the lap goes on the second */
+static_assert(LCD_COLS >= TIMEFMT_LEN + 8, "the display is too narrow");
+static_assert(LCD_ROWS >= 2, "the display needs a row for the lap");
+/* states of the channels other than StopWatchLCD::channel, which uses its own fsm */
+static StopwatchFSM channel_fsm[CONFIG_STOPWATCH_CHANNELS];
+
+#ifdef CONFIG_STOPWATCH_STATUS_DISPLAY
+#include <hd44780.hpp>
+
+/* second display, one channel per row */
+static HD44780_DT_DEFINE(status_display, DT_NODELABEL(status_lcd));
+typedef decltype(status_display)::geometry StatusGeometry;
+
+const uint8_t STATUS_CHANNELS = (StatusGeometry::rows < CONFIG_STOPWATCH_CHANNELS) ? StatusGeometry::rows : CONFIG_STOPWATCH_CHANNELS;
+const uint8_t STATUS_LINE_LEN = 2 + 1 + TIMEFMT_LEN + 1 + 3;   // "00 MM:SS:cc RUN"
+static_assert(STATUS_LINE_LEN <= StatusGeometry::cols, "the status display is too narrow");
+
+/* what is on the status display */
+static char status_shadow[StatusGeometry::rows][StatusGeometry::cols];
+
+static void status_init(void);
+#endif
 
 
 /**
  * @brief Construct a new StopWatchLCD::StopWatchLCD object by initing the LCD.
  * 
  */
-StopWatchLCD::StopWatchLCD(){
+StopWatchLCD::StopWatchLCD() : timing(engine), laps(lap_history){
     hd44780_init();
-    hd44780_cmd(HD44780_CMD_CLEAR, 0);
-    this->state = SW_IDLE;
+#ifdef CONFIG_STOPWATCH_STATUS_DISPLAY
+    status_init();
+#endif
+
+    this->reset_shadow();
+
+    this->restore_session();
+}
+
+/**
+ * @brief the display was just initialised or cleared: spaces everywhere and the address at 0
+ * 
+ */
+void StopWatchLCD::reset_shadow(void){
+    memset(this->shadow, ' ', sizeof(this->shadow));
+    for(uint8_t row = 0; row < LCD_ROWS; row++){
+        this->shadow_valid[row] = true;
+    }
+    this->cursor_row = this->cursor_col = 0;
+    this->cursor_valid = true;
 }
 
 
 
 /**
- * @brief write function for the hd44780
+ * @brief write a single cell, moving the DDRAM address only if it is not already there
  * 
- * @param input_str the string (char arr) to be written on the lcd
- * @param input_str_len length of the string
+ * @param row row of the cell
+ * @param col column of the cell
+ * @param c character to be written
  * 
- * this function is "borrowed" from Curtis Wang git repo:
- *      https://github.com/curtywang/zephyr-hd44780/blob/master/src/main.c
- *              
+ * The controller auto-increments the address after every data write, 
+ * so a run of dirty cells costs one position command. 
+ * The bytes are only queued, the caller has to make sure there is room.
  */
-void StopWatchLCD::write(char* input_str, size_t input_str_len) {
-    for(size_t i = 0; i < 16; i++) {
-        if (i >= input_str_len) {
-            hd44780_data(' ');
-        }
-        else {
-            hd44780_data(input_str[i]);
-        }
+void StopWatchLCD::put_cell(uint8_t row, uint8_t col, char c){
+    if(!this->cursor_valid || this->cursor_row != row || this->cursor_col != col){
+        hd44780_async_pos(row, col);
+        this->frame_bytes_sent++;
+        this->cursor_row = row;
+        this->cursor_col = col;
+        this->cursor_valid = true;
     }
+    hd44780_async_data(c);
+    this->frame_bytes_sent++;
+    this->shadow[row][col] = c;
+    this->cursor_col++;     // past the last column the address leaves the visible row, never matches
 }
 
 
@@ -51,12 +102,73 @@ void StopWatchLCD::write(char* input_str, size_t input_str_len) {
  * @brief write a line at the specified column
  * 
  * @param input_str string to be written
- * @param input_str_len length of string to be written
- * @param column column of the lcd to write the text (must be 0 or 1). 
+ * @param input_str_len length of string to be written, the rest of the line is padded with spaces
+ * @param column column of the lcd to write the text (below LCD_ROWS). 
+ * 
+ * Only cells that differ from what is already displayed are queued for the display.
+ * If the display queue can't take the whole line it is left for the next frame,
+ * so the caller never waits on the display.
  */
-void StopWatchLCD::writeln(char* input_str, size_t input_str_len, uint8_t column){
-        hd44780_pos(column, 0);
-        this->write(input_str, input_str_len);
+void StopWatchLCD::writeln(const char* input_str, size_t input_str_len, uint8_t column){
+    char line[LCD_COLS];
+    bool dirty[LCD_COLS];
+    uint32_t cost = 0;
+
+    if(column >= LCD_ROWS){
+        return;
+    }
+
+    // worst case one position command per dirty cell, fine for an all-or-nothing check
+    for(uint8_t col = 0; col < LCD_COLS; col++){
+        line[col] = (col < input_str_len) ? input_str[col] : ' ';
+        dirty[col] = !this->shadow_valid[column] || this->shadow[column][col] != line[col];
+        if(dirty[col]){
+            cost += 2;
+        }
+    }
+
+    if(cost > hd44780_async_space()){
+        this->rows_deferred++;
+        this->frame_deferred = true;
+        return;
+    }
+
+    for(uint8_t col = 0; col < LCD_COLS; col++){
+        if(dirty[col]){
+            this->put_cell(column, col, line[col]);
+        }else{
+            this->frame_bytes_skipped++;
+        }
+    }
+    this->shadow_valid[column] = true;
+}
+
+/**
+ * @brief forget what is displayed on a column so the next writeln() rewrites all of it
+ * 
+ * @param column column of the lcd (below LCD_ROWS)
+ */
+void StopWatchLCD::invalidate(uint8_t column){
+    if(column < LCD_ROWS){
+        this->shadow_valid[column] = false;
+    }
+}
+
+/**
+ * @brief time one forced, flushed rewrite of the top line, so we know a refresh fits inside a frame
+ * 
+ * Runs once after the first frame, the line is rewritten with what is already on it.
+ */
+void StopWatchLCD::report_line_write(void){
+    char line[LCD_COLS];
+
+    memcpy(line, this->shadow[0], LCD_COLS);
+    this->invalidate(0);
+    uint32_t start = k_cycle_get_32();
+    this->writeln(line, LCD_COLS, 0);
+    hd44780_flush();
+    uint32_t line_us = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+    printk("StopWatchLCD: line write took %u us (frame is %u us)\n", line_us, LCD_UPDATE_PERIOD*1000);
 }
 
 /**
@@ -66,10 +178,10 @@ void StopWatchLCD::writeln(char* input_str, size_t input_str_len, uint8_t column
  * 
  */
 void StopWatchLCD::print_running_time(){
-    uint16_t times[3];
-    this->calculate_min_sec_ms_from_ms(curr_time - offset_timestamp - total_pause_time, times);
-    sprintf(lcd_column0_str,"%02d:%02d:%02d RUNNING", times[0], times[1], times[2]);
-    this->writeln(lcd_column0_str, sizeof(lcd_column0_str), 0);
+    this->run_counter.advance_to(this->ticks_to_centis(this->timing.elapsed(this->channel)));
+    this->run_counter.format(lcd_column0_str);
+    memcpy(lcd_column0_str + TIMEFMT_LEN, " RUNNING", 8);
+    this->writeln(lcd_column0_str, TIMEFMT_LEN + 8, 0);
 
 }
 
@@ -78,10 +190,10 @@ void StopWatchLCD::print_running_time(){
  * 
  */
 void StopWatchLCD::display_paused_time(void){
-    uint16_t times[3];
-    this->calculate_min_sec_ms_from_ms(curr_time - offset_timestamp - total_pause_time, times);
-    sprintf(lcd_column1_str,"%02d:%02d:%02d PAUSED", times[0], times[1], times[2]);
-    this->writeln(lcd_column1_str, sizeof(lcd_column1_str)-1, 0);
+    this->run_counter.advance_to(this->ticks_to_centis(this->timing.elapsed(this->channel)));
+    this->run_counter.format(lcd_column0_str);
+    memcpy(lcd_column0_str + TIMEFMT_LEN, " PAUSED", 7);
+    this->writeln(lcd_column0_str, TIMEFMT_LEN + 7, 0);
 
 }
 
@@ -92,35 +204,94 @@ void StopWatchLCD::display_paused_time(void){
  * 
  */
 void StopWatchLCD::remove_lap_time(void){
-    this->writeln("                ", 16, 1);
+    this->writeln("", 0, 1);
 }
 
 /**
  * @brief set the new laptime and display it
  * 
- * @param timestamp timestamp sampled at the time a lap was requested
+ * @param timestamp timestamp (ticks) of the button edge that requested the lap
+ */
+void StopWatchLCD::set_lap_time(int64_t timestamp){
+    int64_t lap_time = this->timing.lap(this->channel, timestamp);
+
+    this->laps.add(lap_time);
+    struct laplog_session session = this->session_at(timestamp);
+    laplog_add_lap(this->laps.count(), lap_time, &session);
+    telemetry_lap(this->fsm.state, timestamp, lap_time);
+
+    this->show_lap_time(lap_time);
+}
+
+/**
+ * @brief display a lap time on column 1
+ * 
+ * @param duration the lap time in ticks
+ */
+void StopWatchLCD::show_lap_time(int64_t duration){
+    memcpy(this->lcd_column1_str, "LAP ", 4);
+    timefmt_ms(this->lcd_column1_str + 4, this->ticks_to_centis(duration) * 10);
+    this->writeln(this->lcd_column1_str, 4 + TIMEFMT_LEN, 1);
+}
+
+/**
+ * @brief the session as it would be saved
+ * 
+ * @param now timestamp (ticks) the times are taken at
+ * @return struct laplog_session the session
+ */
+struct laplog_session StopWatchLCD::session_at(int64_t now){
+    struct laplog_session session;
+
+    session.state = this->fsm.state;
+    session.elapsed = this->timing.elapsed_at(this->channel, now);
+    session.since_last_lap = this->timing.since_lap_at(this->channel, now);
+    session.num_laps = this->laps.count();
+    return session;
+}
+
+/**
+ * @brief persist the session so it can be restored after a reset
+ * 
+ * @param now timestamp (ticks) the session is saved at
  */
-void StopWatchLCD::set_lap_time(uint32_t timestamp){
-    uint16_t times[3];
-    uint32_t pause_offset = 0;
+void StopWatchLCD::save_session(int64_t now){
+    struct laplog_session session = this->session_at(now);
 
-    if(this->pause_occurred){
-        pause_offset = this->total_pause_time_since_last_lap;
-        this->pause_occurred = false;
+    laplog_save_session(&session);
+    this->session_saved_at = now;
+}
+
+/**
+ * @brief laplog_recover() callback, feeds a stored lap back into the lap history
+ * 
+ */
+static void replay_lap(uint32_t number, int64_t duration, void* user_data){
+    ((LapHistory*)user_data)->add(duration);
+}
+
+/**
+ * @brief restore the laps and the session saved before a reset
+ * 
+ * A session that was running comes back paused at the time it was last saved.
+ */
+void StopWatchLCD::restore_session(void){
+    struct laplog_session session;
+
+    if(laplog_recover(&session, replay_lap, &this->laps) < 0){
+        return;
     }
 
-    if(first_lap){
-        this->lap_time = timestamp - this->offset_timestamp - pause_offset;
-        first_lap = false;
-    }else{
-        this->lap_time = timestamp - this->last_lap_timestamp - pause_offset;
+    this->fsm.restore(session.state);
+    if(this->fsm.state != SW_PAUSE){
+        return;
     }
-    
-    this->last_lap_timestamp = timestamp;
 
-    this->calculate_min_sec_ms_from_ms(lap_time, times);
-    sprintf(this->lcd_column1_str, "LAP %02d:%02d:%02d",times[0], times[1],times[2]);
-    this->writeln(this->lcd_column1_str, 12, 1);
+    this->timing.restore(this->channel, session.elapsed, session.since_last_lap);
+
+    if(this->laps.count() > 0){
+        this->show_lap_time(this->laps.get(0)->duration);
+    }
 }
 
 
@@ -130,20 +301,28 @@ void StopWatchLCD::set_lap_time(uint32_t timestamp){
  * 
  */
 void StopWatchLCD::run_state(void){
-    switch (this->state)
+    this->frame_bytes_sent = 0;
+    this->frame_bytes_skipped = 0;
+    this->frame_skipped = 0;
+    this->frame_deferred = false;
+
+    switch (this->fsm.state)
     {
     case SW_IDLE:
         this->writeln(idle_str, sizeof(idle_str)-1, 0);
         break;
     case SW_RUN:
-        this->curr_time = k_uptime_get_32();
-        this->print_running_time();
-        break;
-    case SW_RUN_W_LAP:
-        this->set_lap_time(this->curr_time);
-        this->curr_time = k_uptime_get_32();
+        this->timing.tick(k_uptime_ticks());
         this->print_running_time();
-        this->state = SW_RUN;
+#ifdef CONFIG_STOPWATCH_LAPLOG
+        if(k_uptime_ticks() - this->session_saved_at >= k_sec_to_ticks_ceil64(CONFIG_STOPWATCH_LAPLOG_SESSION_FLUSH_S)){
+            // the running time only reaches flash with state changes and full lap batches otherwise
+            this->save_session(k_uptime_ticks());
+        }
+#endif
+        if(this->next_centis != 0 && this->run_counter.total_centis > this->next_centis){
+            this->frame_skipped = (this->run_counter.total_centis - this->next_centis) / CONFIG_STOPWATCH_RUN_REFRESH_CENTIS;
+        }
         break;
     case SW_PAUSE:
         this->display_paused_time();
@@ -151,28 +330,329 @@ void StopWatchLCD::run_state(void){
     case SW_RESET:
         this->writeln(reset_str,sizeof(reset_str)-1, 0);
         this->writeln(reset_instr,sizeof(reset_instr)-1, 1); 
-        this->pause_interval = 0;
         break;
     default:
-        this->state = SW_RESET;
         break;
     }
+
+    this->total_bytes_sent += this->frame_bytes_sent;
+    this->total_bytes_skipped += this->frame_bytes_skipped;
+}
+
+/**
+ * @brief when the display has to be drawn again without a gesture
+ * 
+ * @return k_timeout_t absolute timeout for the next frame, K_FOREVER while the screen is static
+ * 
+ * The idle, paused and reset screens only change with a gesture, and every gesture
+ * draws a frame of its own. While a shown channel runs, the next frame is due when 
+ * its time reaches the next multiple of CONFIG_STOPWATCH_RUN_REFRESH_CENTIS, so it is 
+ * drawn right when the digit changes and never when nothing would. The channels on 
+ * the status display count as well.
+ */
+k_timeout_t StopWatchLCD::next_frame(void){
+    if(this->frame_deferred){
+        // the display queue was full, the rest of the frame follows once it drained
+        return K_MSEC(LCD_UPDATE_PERIOD);
+    }
+
+    int64_t now = k_uptime_ticks();
+    int64_t wait = INT64_MAX;
+
+    this->next_centis = 0;
+    if(this->fsm.state == SW_RUN){
+        int64_t elapsed = this->timing.elapsed_at(this->channel, now);
+
+        this->next_centis = this->next_step(elapsed);
+        wait = this->ticks_until(elapsed, this->next_centis);
+    }
+#ifdef CONFIG_STOPWATCH_STATUS_DISPLAY
+    for(uint16_t ch = 0; ch < STATUS_CHANNELS; ch++){
+        if(ch != this->channel && this->timing.is_running(ch)){
+            int64_t elapsed = this->timing.elapsed_at(ch, now);
+
+            wait = MIN(wait, this->ticks_until(elapsed, this->next_step(elapsed)));
+        }
+    }
+#endif
+
+    return (wait == INT64_MAX) ? K_FOREVER : K_TIMEOUT_ABS_TICKS(now + wait);
+}
+
+
+
+
+
+/**
+ * @brief act on a gesture of sw0
+ * 
+ * @param event the gesture
+ * 
+ * The transition comes from the SW_TRANSITIONS table, only the timing actions matter here.
+ * The new state is drawn by the frame the caller starts after the gestures.
+ * 
+ * Start and lap count from the edge that began the press, pause and resume from the 
+ * release edge, so the time between the edge and this thread seeing it doesn't matter.
+ */
+void StopWatchLCD::handle_gesture(const struct gesture_event& event){
+    if(event.channel != this->channel){
+        this->handle_channel_gesture(event);
+        return;
+    }
+
+    uint8_t previous_state = this->fsm.state;
+    uint16_t actions = this->fsm.dispatch(event.type);
+
+    if(actions & ACT_START){
+        this->timing.start(this->channel, event.press_timestamp);
+        this->remove_lap_time();
+        this->laps.clear();
+        laplog_clear();
+    }
+    if(actions & ACT_LAP){
+        this->set_lap_time(event.press_timestamp);
+    }
+    if(actions & ACT_PAUSE){
+        this->timing.pause(this->channel, event.timestamp);     //frozen at the time shown while paused
+    }
+    if(actions & ACT_RESUME){
+        this->timing.resume(this->channel, event.timestamp);
+    }
+
+    if(this->fsm.state != previous_state){
+        int64_t timestamp = (actions & ACT_START) ? event.press_timestamp : event.timestamp;
+
+        this->save_session(timestamp);
+        telemetry_state(this->fsm.state, timestamp, this->timing.elapsed_at(this->channel, timestamp));
+    }
 }
 
 
 
+/**
+ * @brief act on a gesture for one of the other channels, picked by a remote command
+ * 
+ * @param event the gesture, event.channel below CONFIG_STOPWATCH_CHANNELS
+ * 
+ * Same table as the main channel, but only the engine is driven. Their laps are 
+ * not kept, logged or sent, and a reset puts the channel back to zero.
+ */
+void StopWatchLCD::handle_channel_gesture(const struct gesture_event& event){
+    uint16_t ch = event.channel;
+
+    if(ch >= CONFIG_STOPWATCH_CHANNELS){
+        return;
+    }
+
+    uint16_t actions = channel_fsm[ch].dispatch(event.type);
+
+    if(actions & ACT_START){
+        this->timing.start(ch, event.press_timestamp);
+    }
+    if(actions & ACT_LAP){
+        this->timing.lap(ch, event.press_timestamp);
+    }
+    if(actions & ACT_PAUSE){
+        this->timing.pause(ch, event.timestamp);
+    }
+    if(actions & ACT_RESUME){
+        this->timing.resume(ch, event.timestamp);
+    }
+    if(channel_fsm[ch].state == SW_RESET){
+        this->timing.restore(ch, 0, 0);
+    }
+}
+
 
 
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+/**
+ * @brief time hd44780_data(), then writeln() of a whole line including the bus, and of a line that is already displayed
+ * 
+ * The byte timing writes over the display, it is cleared afterwards, so a lap line 
+ * restored at boot is gone. Uses the idle line on column 0, the next run_state() draws over it.
+ */
+void StopWatchLCD::benchmark(void){
+    struct bench_stat full = BENCH_STAT_INIT;
+    struct bench_stat unchanged = BENCH_STAT_INIT;
+
+    // blocking byte writes on the display set up by the constructor, no second init
+    bench_display_bytes();
+    hd44780_cmd(HD44780_CMD_CLEAR, 0);
+    this->reset_shadow();
+
+    for(uint8_t i = 0; i < 16; i++){
+        this->invalidate(0);
+        uint32_t start = k_cycle_get_32();
+        this->writeln(idle_str, sizeof(idle_str)-1, 0);
+        hd44780_flush();
+        bench_stat_add(&full, k_cycle_get_32() - start);
+
+        start = k_cycle_get_32();
+        this->writeln(idle_str, sizeof(idle_str)-1, 0);
+        bench_stat_add(&unchanged, k_cycle_get_32() - start);
+    }
+
+    bench_report("writeln_full", &full);
+    bench_report("writeln_unchanged", &unchanged);
+}
+#endif
+
+
+
+/**
+ * @brief act on every gesture the subscriber has not read yet
+ * 
+ * @param lcd the display
+ * @param channel GestureChannel with the sw0 gestures
+ * @param subscriber subscriber of the display
+ */
+static void lcd_take_gestures(StopWatchLCD& lcd, GestureChannel* channel, struct gesture_subscriber* subscriber){
+    struct gesture_event event;
+
+    while(channel->read(subscriber, &event) == 0){
+        swstats_event(k_cycle_get_32() - event.queued);
+        lcd.handle_gesture(event);
+        if(event.source == GESTURE_SOURCE_REMOTE){
+            // queued is when the command byte arrived
+            swstats_command(k_cycle_get_32() - event.queued);
+        }
+    }
+}
+
+#ifdef CONFIG_STOPWATCH_STATUS_DISPLAY
+/**
+ * @brief set up the status display, blank
+ * 
+ */
+static void status_init(void){
+    status_display.init();
+    memset(status_shadow, ' ', sizeof(status_shadow));
+}
+
+/**
+ * @brief show the first channels of the engine on the status display, one per row
+ * 
+ * @param timing the engine
+ * 
+ * Only the channels on the display are formatted, and only the cells from the 
+ * first to the last changed one of a row are written, in one bus transaction
+ * on an I2C backpack. The writes are blocking.
+ */
+static void status_frame(const SwEngine& timing){
+    uint16_t shown[STATUS_CHANNELS];
+    char times[STATUS_CHANNELS][TIMEFMT_LEN];
+    char line[STATUS_LINE_LEN];
+
+    for(uint8_t row = 0; row < STATUS_CHANNELS; row++){
+        shown[row] = row;
+    }
+    timing.render(shown, STATUS_CHANNELS, times);
+
+    for(uint8_t row = 0; row < STATUS_CHANNELS; row++){
+        timefmt_put2(line, row);
+        line[2] = ' ';
+        memcpy(line + 3, times[row], TIMEFMT_LEN);
+        line[3 + TIMEFMT_LEN] = ' ';
+        memcpy(line + 4 + TIMEFMT_LEN, timing.is_running(row) ? "RUN" : "   ", 3);
+
+        uint8_t first = 0, last = STATUS_LINE_LEN;
+        while(first < last && line[first] == status_shadow[row][first]){
+            first++;
+        }
+        while(last > first && line[last - 1] == status_shadow[row][last - 1]){
+            last--;
+        }
+        if(first < last){
+            status_display.write(row, first, line + first, last - first);
+            memcpy(&status_shadow[row][first], line + first, last - first);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief draw one frame and account for it
+ * 
+ * @param lcd the display
+ * @param due cycle stamp of the timer expiry that asked for the frame
+ * 
+ * A frame that starts so late that the running time moved past the refresh step it
+ * was scheduled for counts the steps it jumped over as skipped frames.
+ */
+static void lcd_frame(StopWatchLCD& lcd, uint32_t due){
+    static bool first_frame = true;
+    uint32_t frame_start = k_cycle_get_32();
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    static uint32_t last_frame_start = 0;
+
+    if(last_frame_start != 0){
+        bench_stat_add(&bench_frame_interval, frame_start - last_frame_start);
+    }
+    last_frame_start = frame_start;
+#endif
+    lcd.run_state();
+#ifdef CONFIG_STOPWATCH_STATUS_DISPLAY
+    lcd.timing.tick(k_uptime_ticks());
+    status_frame(lcd.timing);
+#endif
+    uint32_t render = k_cycle_get_32() - frame_start;
+    if(first_frame){
+        // boot time is tracked up to the first frame being on the glass
+        hd44780_flush();
+        first_frame = false;
+        printk("StopWatchLCD: first frame %u us after boot\n", (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks()));
+        lcd.report_line_write();
+    }
+    swstats_frame(frame_start - due, render, lcd.frame_skipped);
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    bench_stat_add(&bench_frame_render, render);
+#endif
+}
+
+/**
+ * @brief lcd_update_timer expiry function, wakes lcd_run() for the next frame
+ * 
+ * @param timer the timer, user data is the frame k_poll_signal
+ * 
+ * The signal result is the cycle stamp of the expiry, lcd_run() measures its wake-up jitter against it.
+ */
+static void raise_frame_signal(struct k_timer* timer){
+    k_poll_signal_raise((struct k_poll_signal*)k_timer_user_data_get(timer), (int)k_cycle_get_32());
+}
+
+/**
+ * @brief arm the frame timer for the next time the display changes on its own
+ * 
+ * @param lcd the display, after its frame
+ * @param timer the one-shot frame timer
+ * 
+ * On a static screen the timer stays off and nothing wakes up until the next gesture.
+ */
+static void lcd_schedule(StopWatchLCD& lcd, struct k_timer* timer){
+    k_timeout_t next = lcd.next_frame();
+
+    if(K_TIMEOUT_EQ(next, K_FOREVER)){
+        k_timer_stop(timer);
+    }else{
+        k_timer_start(timer, next, K_NO_WAIT);
+    }
+}
+
 /**
  * @brief the main function which ensured the LCD displays the correct information given the buttonpresses
  * 
- * @param p_msgq_time time msgq containing timestamp for buttonpress
- * @param p_msgq_pressed_state sw0 pressed state msgq 
+ * @param p_channel GestureChannel with the sw0 gestures
+ * @param p_subscriber gesture_subscriber of this thread, subscribed to the channel
  * @param unused - not used
  * 
- * utilizes two timers. 
- *  - One for updating the lcd with a period of 50ms
- *  - One for keeping track of how long sw0 was pushed down
+ * utilizes a one-shot timer for updating the lcd, it raises a k_poll signal. Every frame
+ * schedules the next one with StopWatchLCD::next_frame(): while running when the shown 
+ * hundredths change, on the static idle, paused and reset screens not at all. A gesture 
+ * draws a frame right away. How long sw0 was held is decided by the GestureClassifier.
+ * 
+ * The thread blocks in k_poll() on the subscriber semaphore and the frame signal, so it only 
+ * runs when there is a button event or a frame to draw.
  * 
  * 
  * On initialization (bootup), the LCD should display "Stopwatch Ready"
@@ -195,83 +675,137 @@ void StopWatchLCD::run_state(void){
  * While the stopwatch is active, if the button is pressed and held down for at least 4 seconds, 
  * enter the "reset" stopwatch mode.
  */
-void lcd_run(void* p_msgq_pressed_state, void* unused, void* un_used){
+void lcd_run(void* p_channel, void* p_subscriber, void* unused){
 
     StopWatchLCD lcd = StopWatchLCD();
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    lcd.benchmark();
+#endif
 
-    k_msgq* pressed_state_msgq = (k_msgq*)p_msgq_pressed_state;
-
-    bool pressed_state;
-
-    const uint8_t LCD_UPDATE_PERIOD = 50; //ms
-    const uint16_t BUTTON_PRESSED_INTERVAL = 2000; //ms (2 sec)
+    GestureChannel* channel = (GestureChannel*)p_channel;
+    struct gesture_subscriber* subscriber = (struct gesture_subscriber*)p_subscriber;
 
     struct k_timer lcd_update_timer;
-    struct k_timer button_pressed_timer;
+    struct k_poll_signal frame_signal;
 
-    k_timer_init(&lcd_update_timer,NULL, NULL);
-    k_timer_init(&button_pressed_timer,NULL, NULL);
+    k_poll_signal_init(&frame_signal);
+    k_timer_init(&lcd_update_timer, raise_frame_signal, NULL);
+    k_timer_user_data_set(&lcd_update_timer, &frame_signal);
 
-    k_timer_start(&lcd_update_timer, K_MSEC(LCD_UPDATE_PERIOD), K_FOREVER); 
+    // the first frame right away, the display is ready
+    k_timer_start(&lcd_update_timer, K_NO_WAIT, K_NO_WAIT);
 
+    /* sleep until either a button event or a frame deadline */
+    struct k_poll_event events[2] = {
+        K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &subscriber->available),
+        K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &frame_signal),
+    };
 
     while(true){
-        if(k_msgq_get(pressed_state_msgq, &pressed_state, K_NO_WAIT) == 0){ //Successful read- start button-timer
-            if(pressed_state){
-                k_timer_start(&button_pressed_timer, K_MSEC(BUTTON_PRESSED_INTERVAL), K_MSEC(BUTTON_PRESSED_INTERVAL));
-            }
-            //Meaning button was just released - check how many times button_timer has exceeded its time 
-            //      0:  less than 2 sec
-            //      1:  Button pushed between 2 and 4 seconds
-            //      >=2: Button pushed for at least 4 seconds
-            else{
-                uint32_t timer_status = k_timer_status_get(&button_pressed_timer);
-                if(timer_status == 0){ //Button pressed for less than 2 sec
-                    if(lcd.state == SW_IDLE){
-                        lcd.state = SW_RUN;
-                        lcd.offset_timestamp = k_uptime_get_32();
-                    }else if (lcd.state == SW_RUN){
-                        lcd.state = SW_RUN_W_LAP;
-                    }else if(lcd.state == SW_RESET){
-                        lcd.offset_timestamp = k_uptime_get_32();
-                        lcd.total_pause_time = lcd.total_pause_time_since_last_lap = lcd.last_lap_timestamp = 0;
-                        lcd.remove_lap_time();
-                        lcd.first_lap = true;
-                        lcd.pause_occurred = false;
-                        lcd.state = SW_RUN;
-                    }
-                }else if (timer_status == 1){ //Button pushed between 2 and 4 seconds
-
-                    if(lcd.state == SW_RUN){
-                        lcd.pause_timestamp = lcd.curr_time;
-                        lcd.state = SW_PAUSE;
-                    }else if (lcd.state == SW_PAUSE){
-                        lcd.pause_interval = (k_uptime_get() - lcd.pause_timestamp);
-                        lcd.total_pause_time += lcd.pause_interval;
-
-                        if(lcd.pause_occurred){ //If another pause has occurred without new lap time generated
-                            lcd.total_pause_time_since_last_lap += lcd.pause_interval;
-                        }else{
-                            lcd.total_pause_time_since_last_lap = lcd.pause_interval;
-                        }
-                        
-                        lcd.pause_occurred = true; 
-                        lcd.state = SW_RUN;
-                    }
-                    
-                }else if(timer_status  >= 2){ //Button pushed for at least 4 seconds
-                    if(lcd.state == SW_RUN){
-                        lcd.state = SW_RESET;
-                    }
-                }
-                k_timer_stop(&button_pressed_timer);
-            }
+        k_poll(events, 2, K_FOREVER);
+
+        if(events[0].state == K_POLL_STATE_SEM_AVAILABLE){
+            k_sem_take(&subscriber->available, K_NO_WAIT);
+            lcd_take_gestures(lcd, channel, subscriber);
+            // the new state goes on the glass now, not at the next scheduled frame
+            k_timer_start(&lcd_update_timer, K_NO_WAIT, K_NO_WAIT);
         }
 
-        if(k_timer_status_get(&lcd_update_timer) > 0){ //Check if time to update lcd
-            lcd.run_state();
-            k_timer_start(&lcd_update_timer, K_MSEC(LCD_UPDATE_PERIOD), K_FOREVER);
+        if(events[1].state == K_POLL_STATE_SIGNALED){ //time to update lcd
+            unsigned int signaled;
+            int due;
+            k_poll_signal_check(&frame_signal, &signaled, &due);
+            k_poll_signal_reset(&frame_signal);
+            lcd_frame(lcd, (uint32_t)due);
+            lcd_schedule(lcd, &lcd_update_timer);
         }
-        
+
+        events[0].state = K_POLL_STATE_NOT_READY;
+        events[1].state = K_POLL_STATE_NOT_READY;
+    }
+}
+
+
+
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+/* what lcd_run() keeps on its stack, for running the display from work items */
+static struct{
+    StopWatchLCD* lcd;
+    GestureChannel* channel;
+    struct gesture_subscriber* subscriber;
+    struct k_work_q* queue;
+    struct k_timer update_timer;
+    struct k_work init_work;
+    struct k_work gesture_work;
+    struct k_work frame_work;
+    uint32_t frame_due;
+} lcd_work;
+
+alignas(StopWatchLCD) static uint8_t lcd_storage[sizeof(StopWatchLCD)];
+
+/**
+ * @brief work handler, sets up the display on the queue and starts the frames
+ * 
+ */
+static void lcd_init_handler(struct k_work* work){
+    lcd_work.lcd = new(lcd_storage) StopWatchLCD();
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    lcd_work.lcd->benchmark();
+#endif
+    k_timer_start(&lcd_work.update_timer, K_NO_WAIT, K_NO_WAIT);
+    // gestures that came in while the display was set up
+    k_work_submit_to_queue(lcd_work.queue, &lcd_work.gesture_work);
+}
+
+/**
+ * @brief work handler, submitted by the channel when gestures were published
+ * 
+ */
+static void lcd_gesture_handler(struct k_work* work){
+    if(lcd_work.lcd != NULL){
+        lcd_take_gestures(*lcd_work.lcd, lcd_work.channel, lcd_work.subscriber);
+        k_timer_start(&lcd_work.update_timer, K_NO_WAIT, K_NO_WAIT);
     }
 }
+
+/**
+ * @brief work handler, submitted by the update timer
+ * 
+ */
+static void lcd_frame_handler(struct k_work* work){
+    lcd_frame(*lcd_work.lcd, lcd_work.frame_due);
+    lcd_schedule(*lcd_work.lcd, &lcd_work.update_timer);
+}
+
+/**
+ * @brief update timer expiry function in the workqueue variant
+ * 
+ */
+static void submit_frame_work(struct k_timer* timer){
+    lcd_work.frame_due = k_cycle_get_32();
+    k_work_submit_to_queue(lcd_work.queue, &lcd_work.frame_work);
+}
+
+/**
+ * @brief run the display from work items on a workqueue instead of a thread of its own
+ * 
+ * @param queue the started workqueue, its stack replaces the one of lcd_run()
+ * @param channel GestureChannel with the sw0 gestures
+ * @param subscriber subscriber for the display, subscribed here
+ * 
+ * Same behaviour as lcd_run(), the StopWatchLCD lives in static storage instead.
+ */
+void lcd_start(struct k_work_q* queue, GestureChannel* channel, struct gesture_subscriber* subscriber){
+    lcd_work.queue = queue;
+    lcd_work.channel = channel;
+    lcd_work.subscriber = subscriber;
+
+    k_work_init(&lcd_work.init_work, lcd_init_handler);
+    k_work_init(&lcd_work.gesture_work, lcd_gesture_handler);
+    k_work_init(&lcd_work.frame_work, lcd_frame_handler);
+    k_timer_init(&lcd_work.update_timer, submit_frame_work, NULL);
+
+    channel->subscribe(subscriber, queue, &lcd_work.gesture_work);
+    k_work_submit_to_queue(queue, &lcd_work.init_work);
+}
+#endif
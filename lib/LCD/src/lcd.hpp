@@ -2,20 +2,24 @@
 #define LCD_H
 
 #include <hd44780.h>
-#include <cstdlib>
-#include <cstdio>
+#include <gesture.hpp>
+#include <gesturechannel.hpp>
+#include <stopwatchfsm.hpp>
+#include <stopwatchengine.hpp>
+#include "timeformat.hpp"
+#include "laphistory.hpp"
+#include <laplog.hpp>
+#include <telemetry.hpp>
+#include <benchmark.hpp>
+#include <swstats.hpp>
 
-/**
- * @brief The available states for the lcd stopwatch
- * 
- */
-enum states_sw{
-    SW_IDLE = 0,
-    SW_RUN,
-    SW_RUN_W_LAP, 
-    SW_PAUSE,
-    SW_RESET,
-};
+const uint8_t LCD_UPDATE_PERIOD = 50; //ms, retry of a frame the display queue could not take
+/* geometry of the display on HD44780_NODE */
+const uint8_t LCD_ROWS = HD44780_DT_ROWS(HD44780_NODE);
+const uint8_t LCD_COLS = HD44780_DT_COLS(HD44780_NODE);
+
+/* every channel of the board, the display shows one of them */
+typedef StopwatchEngine<CONFIG_STOPWATCH_CHANNELS> SwEngine;
 
 
 /**
@@ -28,54 +32,107 @@ class StopWatchLCD{
 
     public: 
         StopWatchLCD();
-        void write(char* input_str, size_t input_str_len);
-        void writeln(char* input_str, size_t input_str_len, uint8_t column);
+        void writeln(const char* input_str, size_t input_str_len, uint8_t column);
+        void invalidate(uint8_t column);
+        void report_line_write(void);
         void init(void);
         void print_running_time(void);
         void display_paused_time(void);
         void remove_lap_time(void);
-        void set_lap_time(uint32_t timestamp);
+        void set_lap_time(int64_t timestamp);
+        void show_lap_time(int64_t duration);
+        struct laplog_session session_at(int64_t now);
+        void save_session(int64_t now);
+        void restore_session(void);
         void run_state(void);
+        k_timeout_t next_frame(void);
+        void handle_gesture(const struct gesture_event& event);
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+        void benchmark(void);
+#endif
 
-        uint32_t curr_time, offset_timestamp, pause_timestamp;
-        uint32_t last_lap_timestamp = 0;
-        uint32_t lap_time = 0;
-        uint32_t pause_interval = 0;
-        uint32_t total_pause_time = 0;
-        uint32_t total_pause_time_since_last_lap = 0;
-        bool first_lap = true;
-        bool pause_occurred = false;
-        uint8_t state;
+        /* timing of all channels, statically allocated in lcd.cpp. all times in ticks
+         * (k_uptime_ticks()), the button edges are timestamped in the ISR */
+        SwEngine& timing;
+        uint16_t channel = 0;   // the channel sw0 drives and the top line shows
+        StopwatchFSM fsm;
+        /* every lap of the session, statically allocated in lcd.cpp */
+        LapHistory& laps;
 
+        /* bus traffic of the last run_state() and since boot. sent includes DDRAM address commands */
+        uint32_t frame_bytes_sent = 0;
+        uint32_t frame_bytes_skipped = 0;
+        uint32_t total_bytes_sent = 0;
+        uint32_t total_bytes_skipped = 0;
+        /* lines postponed to the next frame because the display queue was full */
+        uint32_t rows_deferred = 0;
+        /* refresh steps of the running time the last run_state() jumped over */
+        uint32_t frame_skipped = 0;
 
 
     private:
-        char lcd_column0_str[16],lcd_column1_str[16];
+        char lcd_column0_str[LCD_COLS],lcd_column1_str[LCD_COLS];
+
+        /* what is currently on the glass, and where the controller's DDRAM address points */
+        char shadow[LCD_ROWS][LCD_COLS];
+        bool shadow_valid[LCD_ROWS];
+        uint8_t cursor_row, cursor_col;
+        bool cursor_valid;
+
         char idle_str[16] = "Stopwatch ready";
         char reset_str[9] = "00:00:00";
         char reset_instr[17] = "Press to restart";
 
+        void put_cell(uint8_t row, uint8_t col, char c);
+        void reset_shadow(void);
+        void handle_channel_gesture(const struct gesture_event& event);
+
+
+        /* the running time shown on the top line, advanced every frame */
+        TimeCounter run_counter;
+        /* when the session was last saved, a running one is saved again every CONFIG_STOPWATCH_LAPLOG_SESSION_FLUSH_S */
+        int64_t session_saved_at = 0;
+        /* centiseconds the scheduled frame is for, 0 while no frame is scheduled */
+        uint32_t next_centis = 0;
+        /* a line of the last run_state() was deferred, it has to run again */
+        bool frame_deferred = false;
 
         /**
-         * @brief private function for converting a given time to minutes, seconds and ms(only two digits)
+         * @brief private function for converting a time in ticks to whole centiseconds
          * 
-         * @param time_ms the time to be converted
-         * @param data_arr an array where the converted data is passed back by reference
+         * @param time_ticks the time to be converted
+         * @return uint32_t the time in centiseconds, 0 for negative times
+         */
+        static uint32_t ticks_to_centis(int64_t time_ticks){
+            return (time_ticks > 0) ? (uint32_t)(k_ticks_to_ms_floor64(time_ticks) / 10) : 0;
+        }
+
+        /**
+         * @brief the next time a running channel is drawn at, CONFIG_STOPWATCH_RUN_REFRESH_CENTIS apart
          * 
-         * data_arr[0] = minutes (MM)
-         * data_arr[1] = minutes (SS)
-         * data_arr[2] = minutes (mm)
+         * @param time_ticks the time on the channel
+         * @return uint32_t the time in centiseconds
          */
-        void calculate_min_sec_ms_from_ms(uint32_t time_ms, uint16_t* data_arr){
+        static uint32_t next_step(int64_t time_ticks){
+            return (ticks_to_centis(time_ticks) / CONFIG_STOPWATCH_RUN_REFRESH_CENTIS + 1) * CONFIG_STOPWATCH_RUN_REFRESH_CENTIS;
+        }
 
-            data_arr[0] = (time_ms/(60000))%60;     //MM;
-            data_arr[1] = (time_ms/1000)%60;        //SS
-            data_arr[2] = (time_ms%1000)/10;        //ms (div by 10 to get 2 digits)
+        /**
+         * @brief ticks from a time until a centisecond value is shown
+         * 
+         * ticks_to_centis() floors, the value is shown from the first tick at or past it
+         */
+        static int64_t ticks_until(int64_t time_ticks, uint32_t centis){
+            return (int64_t)k_ms_to_ticks_ceil64((uint64_t)centis * 10) - time_ticks;
         }
 };
 
 /*The run function for the lcd which is used by one thread. It could not be a member of a class. */
-void lcd_run(void* p_msgq_pressed_state, void* unused, void* un_used);
+void lcd_run(void* p_channel, void* p_subscriber, void* unused);
+
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+void lcd_start(struct k_work_q* queue, GestureChannel* channel, struct gesture_subscriber* subscriber);
+#endif
 
 
 #endif /*LCD_H*/
\ No newline at end of file
@@ -0,0 +1,170 @@
+#ifndef TIMEFORMAT_H
+#define TIMEFORMAT_H
+
+#include <stdint.h>
+
+/*
+ * printf-free formatting of stopwatch times as "MM:SS:cc" straight into the
+ * lcd row buffers. Nothing is NUL terminated, the rows are fixed width.
+ */
+
+const uint8_t TIMEFMT_LEN = 8;     // "MM:SS:cc"
+
+/* two ascii digits for every value 0..99 */
+constexpr char TIMEFMT_DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * @brief write a value 0..99 as two digits
+ * 
+ * @param out destination, 2 chars
+ * @param value the value, must be below 100
+ */
+constexpr void timefmt_put2(char* out, uint8_t value){
+    out[0] = TIMEFMT_DIGIT_PAIRS[2 * value];
+    out[1] = TIMEFMT_DIGIT_PAIRS[2 * value + 1];
+}
+
+/**
+ * @brief write minutes, seconds and centiseconds as "MM:SS:cc"
+ * 
+ * @param out destination, TIMEFMT_LEN chars
+ */
+constexpr void timefmt_put_mm_ss_cc(char* out, uint8_t minutes, uint8_t seconds, uint8_t centis){
+    timefmt_put2(out, minutes);
+    out[2] = ':';
+    timefmt_put2(out + 3, seconds);
+    out[5] = ':';
+    timefmt_put2(out + 6, centis);
+}
+
+/**
+ * @brief write a time in ms as "MM:SS:cc", the minutes wrap at 60
+ * 
+ * @param out destination, TIMEFMT_LEN chars
+ * @param time_ms the time
+ */
+constexpr void timefmt_ms(char* out, uint32_t time_ms){
+    timefmt_put_mm_ss_cc(out, (time_ms / 60000) % 60, (time_ms / 1000) % 60, (time_ms % 1000) / 10);
+}
+
+
+/**
+ * @brief a running "MM:SS:cc" counter that is advanced instead of recomputed
+ * 
+ * Each field is kept as a 0..99 value so it maps onto one TIMEFMT_DIGIT_PAIRS entry. 
+ * Advancing by the few centiseconds between two frames is a couple of compares and 
+ * carries, no division.
+ */
+class TimeCounter{
+    public:
+        constexpr void set_ms(uint32_t time_ms){
+            this->set_centis(time_ms / 10);
+        }
+
+        /**
+         * @brief set the counter from centiseconds, good for 497 days where ms wrap after 49
+         * 
+         * @param time_centis the time in centiseconds
+         */
+        constexpr void set_centis(uint32_t time_centis){
+            this->minutes = (time_centis / 6000) % 60;
+            this->seconds = (time_centis / 100) % 60;
+            this->centis = time_centis % 100;
+            this->total_centis = time_centis;
+        }
+
+        /**
+         * @brief move the counter forward to a new time
+         * 
+         * @param to_centis the new time in centiseconds, falls back to set_centis() if it went 
+         * backwards or jumped a minute or more
+         */
+        constexpr void advance_to(uint32_t to_centis){
+            uint32_t delta = to_centis - this->total_centis;
+
+            if(to_centis < this->total_centis || delta >= 6000){
+                this->set_centis(to_centis);
+                return;
+            }
+            this->total_centis = to_centis;
+
+            uint32_t c = this->centis + delta;
+            uint32_t s = this->seconds;
+            while(c >= 100){
+                c -= 100;
+                s++;
+            }
+            uint32_t m = this->minutes;
+            while(s >= 60){
+                s -= 60;
+                m = (m + 1) % 60;
+            }
+            this->centis = c;
+            this->seconds = s;
+            this->minutes = m;
+        }
+
+        /**
+         * @brief write the counter as "MM:SS:cc"
+         * 
+         * @param out destination, TIMEFMT_LEN chars
+         */
+        constexpr void format(char* out) const {
+            timefmt_put_mm_ss_cc(out, this->minutes, this->seconds, this->centis);
+        }
+
+        uint32_t total_centis = 0;
+        uint8_t minutes = 0;
+        uint8_t seconds = 0;
+        uint8_t centis = 0;
+};
+
+
+/* compile time checks of the formatter */
+constexpr bool timefmt_equals(const char* a, const char* b, uint8_t len){
+    for(uint8_t i = 0; i < len; i++){
+        if(a[i] != b[i]){
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool timefmt_ms_is(uint32_t time_ms, const char* expected){
+    char out[TIMEFMT_LEN] = {};
+    timefmt_ms(out, time_ms);
+    return timefmt_equals(out, expected, TIMEFMT_LEN);
+}
+
+constexpr bool timefmt_counter_is(uint32_t from_ms, uint32_t to_centis, const char* expected){
+    TimeCounter counter;
+    char out[TIMEFMT_LEN] = {};
+    counter.set_ms(from_ms);
+    counter.advance_to(to_centis);
+    counter.format(out);
+    return timefmt_equals(out, expected, TIMEFMT_LEN);
+}
+
+static_assert(timefmt_ms_is(0, "00:00:00"), "timefmt_ms");
+static_assert(timefmt_ms_is(61239, "01:01:23"), "timefmt_ms");
+static_assert(timefmt_ms_is(3599999, "59:59:99"), "timefmt_ms");
+static_assert(timefmt_ms_is(3600000, "00:00:00"), "timefmt_ms minutes wrap");
+static_assert(timefmt_counter_is(0, 5, "00:00:05"), "TimeCounter");
+static_assert(timefmt_counter_is(59990, 6003, "01:00:03"), "TimeCounter carry");
+static_assert(timefmt_counter_is(3599990, 360001, "00:00:01"), "TimeCounter minutes wrap");
+static_assert(timefmt_counter_is(10000, 500, "00:05:00"), "TimeCounter backwards");
+static_assert(timefmt_counter_is(0, 720000, "00:00:00"), "TimeCounter jump");
+static_assert(timefmt_counter_is(0, 500000000, "53:20:00"), "TimeCounter past the 32-bit ms wrap");
+
+
+#endif /*TIMEFORMAT_H*/
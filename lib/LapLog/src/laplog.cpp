@@ -0,0 +1,404 @@
+/**
+ * @file laplog.cpp
+ * @brief Persistent lap log on the storage partition, written in batches through NVS
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include "laplog.hpp"
+
+#ifdef CONFIG_STOPWATCH_LAPLOG
+
+#include <device.h>
+#include <drivers/flash.h>
+#include <storage/flash_map.h>
+#include <fs/nvs.h>
+#include <string.h>
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+#include <benchmark.hpp>
+#include <stopwatchfsm.hpp>
+
+const uint32_t BENCH_LAPLOG_LAPS = 2048;
+const uint8_t BENCH_LAPLOG_RUNS = 4;
+#endif
+
+#define LAPLOG_MAGIC            0x4c415032  // "LAP2"
+#define LAPLOG_HEADER_ID        1
+#define LAPLOG_BATCH_ID_BASE    2
+#define LAPLOG_BATCH_ID(seq)    (LAPLOG_BATCH_ID_BASE + ((seq) % CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES))
+
+BUILD_ASSERT(LAPLOG_BATCH_ID_BASE + CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES < 0xffff, "NVS ids are 16 bit");
+
+/* points at the newest batch and holds the session, rewritten with every commit */
+struct laplog_header{
+    uint32_t magic;
+    uint32_t log_id;        // bumped by laplog_clear(), batches of older logs are ignored
+    uint32_t next_seq;      // batch currently being filled
+    uint32_t has_session;   // session below was saved, a saved START is all zeros otherwise
+    struct laplog_session session;
+};
+
+struct laplog_batch{
+    uint32_t log_id;
+    uint32_t seq;           // position in the log, picks the NVS id
+    uint32_t first_number;  // lap number of durations[0]
+    uint32_t count;
+    int64_t durations[CONFIG_STOPWATCH_LAPLOG_BATCH];
+};
+
+#define LAPLOG_BATCH_SIZE(count) (offsetof(struct laplog_batch, durations) + (count) * sizeof(int64_t))
+
+static struct nvs_fs fs;
+static bool mounted = false;
+
+/* filled by the callers */
+static struct k_spinlock lock;
+static struct laplog_header header;
+static struct laplog_batch pending;
+static struct laplog_batch full_batches[2];
+static uint8_t num_full = 0;
+static bool header_dirty = false;
+static bool pending_dirty = false;
+static uint32_t batches_dropped = 0;
+
+static void laplog_commit(struct k_work* work);
+static int laplog_replay(struct laplog_session* session, laplog_lap_cb cb, void* user_data);
+K_WORK_DEFINE(laplog_commit_work, laplog_commit);
+
+/* given once laplog_init() is done, whether it mounted or not */
+K_SEM_DEFINE(laplog_ready, 0, 1);
+
+
+/**
+ * @brief work item writing everything that piled up since the last commit
+ * 
+ * The records are copied out under the lock and written without it, so adding 
+ * laps never waits for the flash. Batches go first and the header last, a reset 
+ * in between only loses the header update, recovery checks the batch sequence.
+ */
+static void laplog_commit(struct k_work* work){
+    struct laplog_batch batches[ARRAY_SIZE(full_batches) + 1];
+    struct laplog_header header_copy;
+    uint8_t n = 0;
+    bool write_header;
+    uint32_t dropped;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    for(uint8_t i = 0; i < num_full; i++){
+        batches[n++] = full_batches[i];
+    }
+    num_full = 0;
+    if(pending_dirty && pending.count > 0){
+        batches[n++] = pending;
+    }
+    pending_dirty = false;
+    write_header = header_dirty;
+    header_copy = header;
+    header_dirty = false;
+    dropped = batches_dropped;
+    batches_dropped = 0;
+    k_spin_unlock(&lock, key);
+
+    if(dropped > 0){
+        // laps came in faster than the flash took them, they are not in the log
+        printk("LapLog: %u batches (%u laps) dropped before they were written\n",
+               dropped, dropped * CONFIG_STOPWATCH_LAPLOG_BATCH);
+    }
+
+    for(uint8_t i = 0; i < n; i++){
+        ssize_t rc = nvs_write(&fs, LAPLOG_BATCH_ID(batches[i].seq), &batches[i], LAPLOG_BATCH_SIZE(batches[i].count));
+        if(rc < 0){
+            printk("LapLog: batch %u write failed: %d\n", batches[i].seq, (int)rc);
+        }
+    }
+    if(write_header){
+        ssize_t rc = nvs_write(&fs, LAPLOG_HEADER_ID, &header_copy, sizeof(header_copy));
+        if(rc < 0){
+            printk("LapLog: header write failed: %d\n", (int)rc);
+        }
+    }
+}
+
+/**
+ * @brief mount NVS on the storage partition
+ * 
+ * @return int 0 on success, negative errno otherwise
+ */
+static int laplog_mount(void){
+    const struct device* flash_dev = FLASH_AREA_DEVICE(storage);
+    struct flash_pages_info info;
+    int rc;
+
+    if(!device_is_ready(flash_dev)){
+        return -ENODEV;
+    }
+
+    fs.offset = FLASH_AREA_OFFSET(storage);
+    rc = flash_get_page_info_by_offs(flash_dev, fs.offset, &info);
+    if(rc != 0){
+        return rc;
+    }
+    fs.sector_size = info.size;
+    fs.sector_count = FLASH_AREA_SIZE(storage) / info.size;
+
+    rc = nvs_init(&fs, flash_dev->name);
+    if(rc != 0){
+        printk("LapLog: nvs_init failed: %d\n", rc);
+        return rc;
+    }
+
+    if(nvs_read(&fs, LAPLOG_HEADER_ID, &header, sizeof(header)) != sizeof(header) || header.magic != LAPLOG_MAGIC){
+        memset(&header, 0, sizeof(header));
+        header.magic = LAPLOG_MAGIC;
+    }
+    pending.log_id = header.log_id;
+    pending.seq = header.next_seq;
+    pending.count = 0;
+
+    mounted = true;
+    return 0;
+}
+
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+/**
+ * @brief time the recovery of a log of BENCH_LAPLOG_LAPS laps, or as many as it keeps
+ * 
+ * The batches are written straight from here, into a log of their own. Afterwards
+ * an empty log replaces it, so a benchmark build forgets the session saved before.
+ */
+static void laplog_benchmark(void){
+    struct bench_stat stat = BENCH_STAT_INIT;
+    struct laplog_session session = {SW_RUN, 0, 0, 0};
+    struct laplog_batch batch;
+    // the batch next_seq points at shares its NVS id with the oldest one
+    uint32_t batches = MIN(DIV_ROUND_UP(BENCH_LAPLOG_LAPS, CONFIG_STOPWATCH_LAPLOG_BATCH),
+                           CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES - 1);
+
+    header.log_id++;
+    batch.log_id = header.log_id;
+    batch.count = CONFIG_STOPWATCH_LAPLOG_BATCH;
+    for(uint32_t seq = 0; seq < batches; seq++){
+        batch.seq = seq;
+        batch.first_number = seq * CONFIG_STOPWATCH_LAPLOG_BATCH + 1;
+        for(uint32_t i = 0; i < batch.count; i++){
+            batch.durations[i] = k_ms_to_ticks_ceil64(1000 + seq + i);
+        }
+        session.num_laps = batch.first_number + batch.count - 1;
+        session.elapsed += k_ms_to_ticks_ceil64(8000);
+        if(nvs_write(&fs, LAPLOG_BATCH_ID(seq), &batch, LAPLOG_BATCH_SIZE(batch.count)) < 0){
+            printk("BENCH laplog_recover skipped (batch %u write failed)\n", seq);
+            return;
+        }
+    }
+    header.next_seq = batches;
+    header.session = session;
+    header.has_session = true;
+    nvs_write(&fs, LAPLOG_HEADER_ID, &header, sizeof(header));
+
+    int laps = 0;
+    for(uint8_t run = 0; run < BENCH_LAPLOG_RUNS; run++){
+        uint32_t start = k_cycle_get_32();
+        laps = laplog_replay(&session, NULL, NULL);
+        bench_stat_add(&stat, k_cycle_get_32() - start);
+    }
+    printk("BENCH laplog_recover_size laps=%d batches=%u\n", laps, batches);
+    bench_report("laplog_recover", &stat);
+
+    header.log_id++;
+    header.next_seq = 0;
+    header.has_session = false;
+    memset(&header.session, 0, sizeof(header.session));
+    pending.log_id = header.log_id;
+    pending.seq = 0;
+    pending.count = 0;
+    nvs_write(&fs, LAPLOG_HEADER_ID, &header, sizeof(header));
+}
+#endif
+
+/**
+ * @brief mount the log, laplog_recover() waits for this
+ * 
+ * @return int 0 on success, negative errno otherwise
+ */
+int laplog_init(void){
+    int rc = laplog_mount();
+
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    if(rc == 0){
+        laplog_benchmark();     //before anyone can recover the log it replaces
+    }
+#endif
+    k_sem_give(&laplog_ready);
+    return rc;
+}
+
+/**
+ * @brief the session as it was last saved
+ * 
+ * @param session receives the session
+ * @return int 0 on success, -ENOENT if nothing was saved, -ENODEV if not mounted
+ */
+int laplog_read_session(struct laplog_session* session){
+    if(!mounted){
+        return -ENODEV;
+    }
+    if(!header.has_session){
+        return -ENOENT;
+    }
+    *session = header.session;
+    return 0;
+}
+
+/**
+ * @brief laplog_recover() of a mounted log
+ * 
+ */
+static int laplog_replay(struct laplog_session* session, laplog_lap_cb cb, void* user_data){
+    struct laplog_batch batch;
+    int laps = 0;
+
+    int rc = laplog_read_session(session);
+    if(rc != 0){
+        return rc;
+    }
+
+    uint32_t first_seq = (header.next_seq >= CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES) ? 
+                            header.next_seq - CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES + 1 : 0;
+
+    for(uint32_t seq = first_seq; seq <= header.next_seq; seq++){
+        ssize_t len = nvs_read(&fs, LAPLOG_BATCH_ID(seq), &batch, sizeof(batch));
+        if(len < (ssize_t)LAPLOG_BATCH_SIZE(0) || batch.log_id != header.log_id || batch.seq != seq ||
+                batch.count > CONFIG_STOPWATCH_LAPLOG_BATCH || len < (ssize_t)LAPLOG_BATCH_SIZE(batch.count)){
+            continue;   // never written, or left over from an older log
+        }
+        for(uint32_t i = 0; i < batch.count; i++){
+            if(cb != NULL){
+                cb(batch.first_number + i, batch.durations[i], user_data);
+            }
+            laps++;
+        }
+        if(seq == header.next_seq){
+            k_spinlock_key_t key = k_spin_lock(&lock);
+            pending = batch;
+            k_spin_unlock(&lock, key);
+        }
+    }
+
+    return laps;
+}
+
+/**
+ * @brief replay the stored laps, oldest first, and return the saved session
+ * 
+ * @param session receives the session
+ * @param cb called for every stored lap, may be NULL
+ * @param user_data passed to cb
+ * @return int number of laps replayed, negative errno otherwise
+ * 
+ * The partially filled batch at the end is taken over, so new laps are appended to it.
+ * Blocks until laplog_init() has run, so the display can be set up in parallel with it.
+ */
+int laplog_recover(struct laplog_session* session, laplog_lap_cb cb, void* user_data){
+    // leave the semaphore given for everyone else
+    k_sem_take(&laplog_ready, K_FOREVER);
+    k_sem_give(&laplog_ready);
+
+    uint32_t start = k_cycle_get_32();
+    int laps = laplog_replay(session, cb, user_data);
+
+    if(laps >= 0){
+        printk("LapLog: recovered %d laps in %u us\n", laps, k_cyc_to_us_ceil32(k_cycle_get_32() - start));
+    }
+    return laps;
+}
+
+/**
+ * @brief queue a lap, it is written once its batch is full or the session is saved
+ * 
+ * @param number lap number in the session, starting at 1
+ * @param duration lap duration in ticks
+ * @param session the session right after the lap, goes out with the batch so a
+ *                full batch also brings the saved running time up to date
+ */
+void laplog_add_lap(uint32_t number, int64_t duration, const struct laplog_session* session){
+    bool submit = false;
+
+    if(!mounted){
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    if(pending.count == 0){
+        pending.first_number = number;
+    }
+    pending.durations[pending.count++] = duration;
+    header.session = *session;
+    header.session.num_laps = number;
+    header.has_session = true;
+
+    if(pending.count == CONFIG_STOPWATCH_LAPLOG_BATCH){
+        if(num_full < ARRAY_SIZE(full_batches)){
+            full_batches[num_full++] = pending;
+        }else{
+            batches_dropped++;
+        }
+        header.next_seq++;
+        header_dirty = true;
+        pending.seq = header.next_seq;
+        pending.count = 0;
+        submit = true;
+    }
+    k_spin_unlock(&lock, key);
+
+    if(submit){
+        k_work_submit(&laplog_commit_work);
+    }
+}
+
+/**
+ * @brief save the session, together with the laps of the unfinished batch
+ * 
+ * @param session the session, num_laps is kept from laplog_add_lap()
+ */
+void laplog_save_session(const struct laplog_session* session){
+    if(!mounted){
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    uint32_t num_laps = header.session.num_laps;
+    header.session = *session;
+    header.session.num_laps = num_laps;
+    header.has_session = true;
+    header_dirty = true;
+    pending_dirty = true;
+    k_spin_unlock(&lock, key);
+
+    k_work_submit(&laplog_commit_work);
+}
+
+/**
+ * @brief start a new, empty log, the old batches are ignored from now on
+ * 
+ */
+void laplog_clear(void){
+    if(!mounted){
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    header.log_id++;
+    header.next_seq = 0;
+    header.session.num_laps = 0;
+    header_dirty = true;
+    pending.log_id = header.log_id;
+    pending.seq = 0;
+    pending.count = 0;
+    num_full = 0;
+    k_spin_unlock(&lock, key);
+
+    k_work_submit(&laplog_commit_work);
+}
+
+#endif /* CONFIG_STOPWATCH_LAPLOG */
@@ -0,0 +1,46 @@
+#ifndef LAPLOG_H
+#define LAPLOG_H
+
+#include <zephyr.h>
+
+/**
+ * @brief the part of the stopwatch that survives a reset
+ * 
+ */
+struct laplog_session{
+    uint8_t state;              // states_sw when it was saved
+    int64_t elapsed;            // ticks on the stopwatch when it was saved
+    int64_t since_last_lap;     // ticks since the last lap (or the start) when it was saved
+    uint32_t num_laps;          // laps of the session, also the ones not committed yet
+};
+
+typedef void (*laplog_lap_cb)(uint32_t number, int64_t duration, void* user_data);
+
+/*
+ * Append-only lap log on the storage partition through NVS.
+ *
+ * Laps are collected in batches of CONFIG_STOPWATCH_LAPLOG_BATCH and the 
+ * session record is updated with them, all written from a work item on the 
+ * system workqueue, so callers never wait on a flash erase. Besides the state
+ * changes, the display saves a running session every 
+ * CONFIG_STOPWATCH_LAPLOG_SESSION_FLUSH_S, so a reset loses at most that much. The last 
+ * CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES batches are kept, NVS does the wear levelling.
+ */
+#ifdef CONFIG_STOPWATCH_LAPLOG
+int laplog_init(void);
+int laplog_read_session(struct laplog_session* session);
+int laplog_recover(struct laplog_session* session, laplog_lap_cb cb, void* user_data);
+void laplog_add_lap(uint32_t number, int64_t duration, const struct laplog_session* session);
+void laplog_save_session(const struct laplog_session* session);
+void laplog_clear(void);
+#else
+static inline int laplog_init(void) {return -ENOTSUP;}
+static inline int laplog_read_session(struct laplog_session* session) {return -ENOTSUP;}
+static inline int laplog_recover(struct laplog_session* session, laplog_lap_cb cb, void* user_data) {return -ENOTSUP;}
+static inline void laplog_add_lap(uint32_t number, int64_t duration, const struct laplog_session* session) {}
+static inline void laplog_save_session(const struct laplog_session* session) {}
+static inline void laplog_clear(void) {}
+#endif
+
+
+#endif /*LAPLOG_H*/
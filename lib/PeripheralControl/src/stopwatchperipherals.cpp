@@ -31,44 +31,59 @@ void StopWatchPeripherals::init(gpio_callback_handler_t callback){
     gpio_init_callback(&sw0_callback, callback, BIT(spec_pin_sw0.pin));
     gpio_add_callback(spec_pin_sw0.port, &sw0_callback);
 
-    this->state = P_IDLE;
+    /* continue the session the display restores, both LEDs are lit while the stopwatch is idle */
+    struct laplog_session session;
+    if(laplog_read_session(&session) == 0){
+        this->fsm.restore(session.state);
+    }
+    this->run_actions((this->fsm.state == SW_IDLE) ? ACT_LEDS_ON : ACT_LEDS_OFF);
 
 }
 
 /**
- * @brief run the current state of the object
+ * @brief carry out the LED part of a transition's actions
  * 
+ * @param actions sw_actions from the SW_TRANSITIONS table
  */
-void StopWatchPeripherals::run_state(void){
-    switch (this->state)
-    {
-    case P_IDLE:
-        this->turn_on_led0();
-        this->turn_on_led1();
-    case P_RUN:
-        this->turn_off_led0();
-        this->turn_off_led1();
-    case P_PAUSE:
+void StopWatchPeripherals::run_actions(uint16_t actions){
+    if(actions & ACT_LEDS_OFF){
         this->turn_off_led0();
         this->turn_off_led1();
-        break;
-    case P_RESET:
+    }
+    if(actions & ACT_LEDS_ON){
+        this->turn_on_led0();
+        this->turn_on_led1();
+    }
+    if(actions & ACT_LED0_ON){
         this->turn_on_led0();
+    }
+    if(actions & ACT_LED1_ON){
         this->turn_on_led1();
-        break;
-    default:
-        this->state = P_RESET;
-        break;
     }
 }
 
+/**
+ * @brief act on a gesture of sw0
+ * 
+ * @param event the gesture
+ * 
+ * The transition comes from the SW_TRANSITIONS table, the same one the display uses.
+ * The LEDs follow channel 0, gestures for the other channels are left out.
+ */
+void StopWatchPeripherals::handle_gesture(const struct gesture_event& event){
+    if(event.channel != 0){
+        return;
+    }
+    this->run_actions(this->fsm.dispatch(event.type));
+}
+
 
 /**
  * @brief function for controlling led0 and led1 according to the instructions below
  * 
  * @param p_peripherals The peripheral object 
- * @param p_msgq_pressed_state msgq with the button state (pressed or not pressed)
- * @param unused unused
+ * @param p_channel GestureChannel with the sw0 gestures
+ * @param p_subscriber gesture_subscriber of this thread, subscribed to the channel
  * 
  * On initialization (bootup), both of the LEDs should remain lit.
  * When the button is pressed and released within 2 seconds, turn off both LEDs
@@ -85,70 +100,59 @@ void StopWatchPeripherals::run_state(void){
  * activate both of the LEDs to signal to the user that we have held for at least 4 seconds, 
  * and enter the "reset" stopwatch mode.
  */
-void run_leds(void* p_peripherals, void* p_msgq_pressed_state, void* unused){
+void run_leds(void* p_peripherals, void* p_channel, void* p_subscriber){
 
     StopWatchPeripherals* peripherals = (StopWatchPeripherals*)p_peripherals;
-    k_msgq* pressed_state_msgq = (k_msgq*)p_msgq_pressed_state;
-
-    bool pressed_state = false;
-    const uint16_t BUTTON_PRESSED_INTERVAL = 2000; //ms (2 sec)
-    uint8_t num_times_expired = 0;
+    GestureChannel* channel = (GestureChannel*)p_channel;
+    struct gesture_subscriber* subscriber = (struct gesture_subscriber*)p_subscriber;
 
-    uint32_t timer_status;
+    struct gesture_event event;
 
-    struct k_timer button_pressed_p_timer;
-    struct k_timer button_check_timer;
+    /* the GestureClassifier times the holds, so there is nothing to do between events */
+    while(true){
+        k_sem_take(&subscriber->available, K_FOREVER);
+        while(channel->read(subscriber, &event) == 0){
+            peripherals->handle_gesture(event);
+        }
+    }
+}
 
-    k_timer_init(&button_pressed_p_timer,NULL, NULL);
-    k_timer_init(&button_check_timer,NULL, NULL);
 
-    k_timer_start(&button_check_timer, K_MSEC(1), K_FOREVER);
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+/* what run_leds() keeps on its stack, for running the LEDs from a work item */
+static struct{
+    StopWatchPeripherals* peripherals;
+    GestureChannel* channel;
+    struct gesture_subscriber* subscriber;
+    struct k_work gesture_work;
+} leds_work;
 
-    
-    while(true){
-        
-        if(k_msgq_get(pressed_state_msgq, &pressed_state, K_NO_WAIT) == 0){ //Successful read- start button-timer
-            if(pressed_state){
-                k_timer_start(&button_pressed_p_timer, K_MSEC(BUTTON_PRESSED_INTERVAL), K_MSEC(BUTTON_PRESSED_INTERVAL));
-                num_times_expired = 0;
-            }
-            //Meaning button was just released - check how many times button_timer has exceeded its time 
-            //      0:  less than 2 sec
-            //      1:  Button pushed between 2 and 4 seconds
-            //      >=2: Button pushed for at least 4 seconds
-            else{
-                timer_status = k_timer_status_get(&button_pressed_p_timer);
-                peripherals->turn_off_led0();
-                peripherals->turn_off_led1();
-                if(timer_status == 0){
-                    if(peripherals->state == P_RESET){
-                        peripherals->state = P_RUN;
-                    }
-                }
-                if(timer_status >= 2){
-                    if(peripherals->state == P_IDLE){
-                        peripherals->state = P_RESET;
-                        peripherals->run_state();
-                    }
-                }
-                k_timer_stop(&button_pressed_p_timer);
-            }
-        }
+/**
+ * @brief work handler, submitted by the channel when gestures were published
+ * 
+ */
+static void leds_gesture_handler(struct k_work* work){
+    struct gesture_event event;
 
-        if(k_timer_status_get(&button_check_timer) > 0){
-            if(pressed_state){ //button is still pushed down
-                timer_status = k_timer_status_get(&button_pressed_p_timer);
-                if(timer_status > 0){
-                    num_times_expired += 1;
-                }
-                if(num_times_expired == 1){
-                    peripherals->turn_on_led0();
-                }else if (num_times_expired == 2){
-                    peripherals->turn_on_led1();
-                }
-            }
-            k_timer_start(&button_check_timer, K_MSEC(1), K_FOREVER);
-        }
-        k_msleep(1); //had to add some sleep ?
+    while(leds_work.channel->read(leds_work.subscriber, &event) == 0){
+        leds_work.peripherals->handle_gesture(event);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief run the LEDs from a work item on a workqueue instead of a thread of their own
+ * 
+ * @param queue the started workqueue
+ * @param peripherals the peripheral object, initialised
+ * @param channel GestureChannel with the sw0 gestures
+ * @param subscriber subscriber for the LEDs, subscribed here
+ */
+void leds_start(struct k_work_q* queue, StopWatchPeripherals* peripherals, GestureChannel* channel, struct gesture_subscriber* subscriber){
+    leds_work.peripherals = peripherals;
+    leds_work.channel = channel;
+    leds_work.subscriber = subscriber;
+
+    k_work_init(&leds_work.gesture_work, leds_gesture_handler);
+    channel->subscribe(subscriber, queue, &leds_work.gesture_work);
+}
+#endif
@@ -1,6 +1,10 @@
 #ifndef PERIPHERALCONTROL_H
 #define PERIPHERALCONTROL_H
 
+#include <gesture.hpp>
+#include <gesturechannel.hpp>
+#include <stopwatchfsm.hpp>
+#include <laplog.hpp>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,17 +16,6 @@ extern "C" {
 #include <device.h>
 
 
-/**
- * @brief valid states for the peripherals
- * 
- */
-enum states_p{
-    P_IDLE = 0,
-    P_RUN,
-    P_PAUSE,
-    P_RESET
-};
-
 /**
  * @brief class for controlling the peripherals needed for the stopwatch
  * 
@@ -38,17 +31,22 @@ class StopWatchPeripherals{
         void turn_on_led1(void) {gpio_pin_set_dt(&spec_pin_led1, 1);}
         void turn_off_led1(void) {gpio_pin_set_dt(&spec_pin_led1, 0);}
         void init(gpio_callback_handler_t callback);
-        void run_state(void);
+        void run_actions(uint16_t actions);
+        void handle_gesture(const struct gesture_event& event);
         struct gpio_callback sw0_callback;
         const struct gpio_dt_spec spec_pin_led0 = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
         const struct gpio_dt_spec spec_pin_led1 = GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios);
         const struct gpio_dt_spec spec_pin_sw0 = GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios);
-        uint8_t state;
+        StopwatchFSM fsm;
 
 };
 
 /*the function called by the thread. This could not be inside a class for some reason*/
-void run_leds(void* p_peripherals, void* p_msgq_pressed_state, void* unused);
+void run_leds(void* p_peripherals, void* p_channel, void* p_subscriber);
+
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+void leds_start(struct k_work_q* queue, StopWatchPeripherals* peripherals, GestureChannel* channel, struct gesture_subscriber* subscriber);
+#endif
 
 
 #ifdef __cplusplus
@@ -0,0 +1,202 @@
+/**
+ * @file remote.cpp
+ * @brief Remote start/lap/pause/reset commands on a UART, parsed in the RX interrupt
+ * @version 0.1
+ *
+ *
+ */
+
+#include "remote.hpp"
+
+#ifdef CONFIG_STOPWATCH_REMOTE
+
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+
+/* bytes taken out of the UART FIFO per read in the interrupt */
+#define REMOTE_RX_CHUNK 8
+
+static const struct device* uart_dev = DEVICE_DT_GET(DT_CHOSEN(stopwatch_remote_uart));
+
+static struct{
+    struct k_spinlock lock;
+    GestureChannel* channel;
+    struct remote_stats stats;
+    struct k_timer poll_timer;  // only without the interrupt API
+    uint8_t selected;           // channel of the next command, set by a digit
+} remote;
+
+
+/**
+ * @brief the gesture a command byte stands for
+ *
+ * @param c the byte
+ * @return uint8_t gesture_type, GESTURE_NUM_TYPES if it is no command
+ */
+static uint8_t remote_gesture(uint8_t c){
+    if(c >= 'a' && c <= 'z'){
+        c -= 'a' - 'A';
+    }
+
+    switch(c){
+    case REMOTE_CMD_START:
+        return GESTURE_KEY_START;
+    case REMOTE_CMD_LAP:
+        return GESTURE_KEY_LAP;
+    case REMOTE_CMD_PAUSE:
+        return GESTURE_KEY_PAUSE;
+    case REMOTE_CMD_RESET:
+        return GESTURE_KEY_RESET;
+    default:
+        return GESTURE_NUM_TYPES;
+    }
+}
+
+/**
+ * @brief parse the bytes of one read and publish the commands, in the interrupt (or poll timer)
+ *
+ * A digit picks the channel of the command after it, which may come with the next read.
+ *
+ * @param buf the bytes
+ * @param len number of bytes
+ * @param timestamp k_uptime_ticks() when they arrived
+ * @param cycles k_cycle_get_32() when they arrived
+ */
+static void remote_parse(const uint8_t* buf, int len, int64_t timestamp, uint32_t cycles){
+    uint32_t commands = 0, ignored = 0;
+
+    for(int i = 0; i < len; i++){
+        uint8_t gesture = remote_gesture(buf[i]);
+
+        if(gesture < GESTURE_NUM_TYPES){
+            struct gesture_event event = {gesture, timestamp, timestamp, cycles, GESTURE_SOURCE_REMOTE, remote.selected};
+
+            remote.channel->publish(event);
+            remote.selected = 0;
+            commands++;
+        }else if(buf[i] >= '0' && buf[i] < '0' + MIN(CONFIG_STOPWATCH_CHANNELS, 10)){
+            remote.selected = buf[i] - '0';
+        }else if(buf[i] != '\r' && buf[i] != '\n'){
+            remote.selected = 0;
+            ignored++;
+        }
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&remote.lock);
+    remote.stats.commands += commands;
+    remote.stats.ignored += ignored;
+    k_spin_unlock(&remote.lock, key);
+}
+
+#ifdef CONFIG_UART_INTERRUPT_DRIVEN
+/**
+ * @brief UART interrupt, reads and parses whatever has arrived
+ *
+ * Bytes that piled up in a FIFO share the stamp of the interrupt, which is
+ * when the last of them arrived.
+ */
+static void remote_uart_isr(const struct device* dev, void* user_data){
+    int64_t timestamp = k_uptime_ticks();
+    uint32_t cycles = k_cycle_get_32();
+    uint8_t buf[REMOTE_RX_CHUNK];
+
+    while(uart_irq_update(dev) && uart_irq_is_pending(dev)){
+        if(!uart_irq_rx_ready(dev)){
+            break;
+        }
+        if(uart_err_check(dev) & UART_ERROR_OVERRUN){
+            k_spinlock_key_t key = k_spin_lock(&remote.lock);
+            remote.stats.overruns++;
+            k_spin_unlock(&remote.lock, key);
+        }
+
+        int len = uart_fifo_read(dev, buf, sizeof(buf));
+        remote_parse(buf, len, timestamp, cycles);
+    }
+}
+#endif
+
+/**
+ * @brief poll timer expiry, for UARTs without the interrupt API
+ *
+ */
+static void remote_poll(struct k_timer* timer){
+    int64_t timestamp = k_uptime_ticks();
+    uint32_t cycles = k_cycle_get_32();
+    uint8_t buf[REMOTE_RX_CHUNK];
+    int len = 0;
+
+    while(len < REMOTE_RX_CHUNK && uart_poll_in(uart_dev, &buf[len]) == 0){
+        len++;
+    }
+    remote_parse(buf, len, timestamp, cycles);
+}
+
+/**
+ * @brief start receiving commands
+ *
+ * @param channel channel the commands are published to as GESTURE_KEY_* gestures
+ * @return int 0 on success, negative errno otherwise
+ */
+int remote_init(GestureChannel* channel){
+    uint8_t c;
+
+    if(!device_is_ready(uart_dev)){
+        return -ENODEV;
+    }
+
+    remote.channel = channel;
+    // whatever was sent before we listened is stale
+    while(uart_poll_in(uart_dev, &c) == 0){
+    }
+
+#ifdef CONFIG_UART_INTERRUPT_DRIVEN
+    if(uart_irq_callback_user_data_set(uart_dev, remote_uart_isr, NULL) == 0){
+        remote.stats.irq = true;
+        uart_irq_rx_enable(uart_dev);
+    }
+#endif
+    if(!remote.stats.irq){
+        k_timer_init(&remote.poll_timer, remote_poll, NULL);
+        k_timer_start(&remote.poll_timer, K_USEC(CONFIG_STOPWATCH_REMOTE_POLL_US),
+                      K_USEC(CONFIG_STOPWATCH_REMOTE_POLL_US));
+    }
+
+    printk("Remote on %s (%s)\n", uart_dev->name, remote.stats.irq ? "irq" : "polled");
+    return 0;
+}
+
+/**
+ * @brief the receive counters since boot
+ *
+ * @param stats receives the counters
+ */
+void remote_stats(struct remote_stats* stats){
+    k_spinlock_key_t key = k_spin_lock(&remote.lock);
+    *stats = remote.stats;
+    k_spin_unlock(&remote.lock, key);
+}
+
+
+#ifdef CONFIG_SHELL
+#include <shell/shell.h>
+
+static int cmd_remote_stats(const struct shell* sh, size_t argc, char** argv){
+    struct remote_stats stats;
+
+    remote_stats(&stats);
+    shell_print(sh, "commands %u ignored %u overruns %u (%s)", stats.commands, stats.ignored,
+                stats.overruns, stats.irq ? "irq" : "polled");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_remote,
+    SHELL_CMD(stats, NULL, "Commands received and bytes ignored", cmd_remote_stats),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(remote, &sub_remote, "Remote command UART", NULL);
+#endif
+
+#endif // CONFIG_STOPWATCH_REMOTE
@@ -0,0 +1,59 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <zephyr.h>
+#include <gesturechannel.hpp>
+
+/*
+ * Command protocol, one ASCII byte per command:
+ *
+ *   S  start, or resume when paused    (GESTURE_KEY_START)
+ *   L  lap                             (GESTURE_KEY_LAP)
+ *   P  pause                           (GESTURE_KEY_PAUSE)
+ *   R  reset                           (GESTURE_KEY_RESET)
+ *
+ * Lower case works as well. A digit in front of a command picks the channel
+ * it is for, "2S" starts channel 2; without one it goes to channel 0, the one
+ * on the main display, sw0 and the keypad drive. Digits of channels past
+ * CONFIG_STOPWATCH_CHANNELS are ignored. CR and LF are skipped so a terminal
+ * can be used, every other byte is counted as ignored and drops a pending
+ * digit. A command takes effect with the byte that carries it, there is
+ * nothing to wait for.
+ */
+const char REMOTE_CMD_START = 'S';
+const char REMOTE_CMD_LAP = 'L';
+const char REMOTE_CMD_PAUSE = 'P';
+const char REMOTE_CMD_RESET = 'R';
+
+/**
+ * @brief receive counters since boot
+ *
+ */
+struct remote_stats{
+    uint32_t commands;      // published as gestures
+    uint32_t ignored;       // bytes that are no command
+    uint32_t overruns;      // times the UART lost bytes before they were read
+    bool irq;               // false if the UART has no interrupt API and is polled
+};
+
+/*
+ * Remote control on the UART chosen as stopwatch,remote-uart.
+ *
+ * Bytes are read and parsed in the UART RX interrupt. Each command is stamped
+ * with k_uptime_ticks() and the cycle counter on entry to the interrupt, and
+ * published right there on the channel sw0 and the keypad use, so a remote
+ * lap counts from when its byte arrived, like a button edge. UARTs without
+ * the interrupt API (native_posix) are polled from a timer every
+ * CONFIG_STOPWATCH_REMOTE_POLL_US instead, which is also how late a
+ * timestamp can be there. The time from the byte to the new state is kept in
+ * the "remote command" histogram of "stopwatch stats".
+ */
+#ifdef CONFIG_STOPWATCH_REMOTE
+int remote_init(GestureChannel* channel);
+void remote_stats(struct remote_stats* stats);
+#else
+static inline int remote_init(GestureChannel* channel) {return -ENOTSUP;}
+#endif
+
+
+#endif /*REMOTE_H*/
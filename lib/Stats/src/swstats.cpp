@@ -0,0 +1,163 @@
+/**
+ * @file swstats.cpp
+ * @brief Lock-free latency histograms and the "stopwatch stats" shell command
+ * @version 0.1
+ *
+ *
+ */
+
+#include "swstats.hpp"
+
+#ifdef CONFIG_STOPWATCH_STATS
+
+#ifdef CONFIG_SHELL
+#include <shell/shell.h>
+#endif
+
+static struct log_hist frame_render;
+static struct log_hist frame_jitter;
+static struct log_hist event_residency;
+static struct log_hist command_latency;
+static atomic_t deadline_misses;
+
+
+/**
+ * @brief count a value
+ *
+ * @param hist the histogram
+ * @param value the value in us
+ */
+void log_hist_add(struct log_hist* hist, uint32_t value){
+    uint8_t bucket = (value == 0) ? 0 : 32 - __builtin_clz(value);
+    atomic_val_t max;
+
+    if(bucket >= LOG_HIST_BUCKETS){
+        bucket = LOG_HIST_BUCKETS - 1;
+    }
+    atomic_inc(&hist->buckets[bucket]);
+
+    do{
+        max = atomic_get(&hist->max);
+        if((uint32_t)max >= value){
+            break;
+        }
+    }while(!atomic_cas(&hist->max, max, (atomic_val_t)value));
+}
+
+/**
+ * @brief clear a histogram. Counts added while it runs may survive in the lower buckets
+ *
+ * @param hist the histogram
+ */
+void log_hist_reset(struct log_hist* hist){
+    for(uint8_t i = 0; i < LOG_HIST_BUCKETS; i++){
+        atomic_set(&hist->buckets[i], 0);
+    }
+    atomic_set(&hist->max, 0);
+}
+
+/**
+ * @brief account one frame of lcd_run()
+ *
+ * @param jitter_cycles time from the timer expiry until the frame started
+ * @param render_cycles time spent in run_state()
+ * @param missed frames skipped before this one
+ */
+void swstats_frame(uint32_t jitter_cycles, uint32_t render_cycles, uint32_t missed){
+    log_hist_add(&frame_jitter, k_cyc_to_us_floor32(jitter_cycles));
+    log_hist_add(&frame_render, k_cyc_to_us_floor32(render_cycles));
+    if(missed > 0){
+        atomic_add(&deadline_misses, missed);
+    }
+}
+
+/**
+ * @brief account one button event taken out of its queue
+ *
+ * @param residency_cycles time between queueing and dequeueing
+ */
+void swstats_event(uint32_t residency_cycles){
+    log_hist_add(&event_residency, k_cyc_to_us_floor32(residency_cycles));
+}
+
+/**
+ * @brief account one remote command that has been acted on
+ *
+ * @param latency_cycles time from the arrival of its byte until the state changed
+ */
+void swstats_command(uint32_t latency_cycles){
+    log_hist_add(&command_latency, k_cyc_to_us_floor32(latency_cycles));
+}
+
+/**
+ * @brief start over with empty histograms
+ *
+ */
+void swstats_reset(void){
+    log_hist_reset(&frame_render);
+    log_hist_reset(&frame_jitter);
+    log_hist_reset(&event_residency);
+    log_hist_reset(&command_latency);
+    atomic_set(&deadline_misses, 0);
+}
+
+
+#ifdef CONFIG_SHELL
+/**
+ * @brief print the non-empty buckets of a histogram
+ *
+ */
+static void log_hist_print(const struct shell* sh, const char* name, struct log_hist* hist){
+    uint32_t counts[LOG_HIST_BUCKETS];
+    uint32_t total = 0;
+
+    // copy first, so the total matches the buckets printed
+    for(uint8_t i = 0; i < LOG_HIST_BUCKETS; i++){
+        counts[i] = (uint32_t)atomic_get(&hist->buckets[i]);
+        total += counts[i];
+    }
+
+    shell_print(sh, "%s: n=%u max=%u us", name, total, (uint32_t)atomic_get(&hist->max));
+    for(uint8_t i = 0; i < LOG_HIST_BUCKETS; i++){
+        if(counts[i] == 0){
+            continue;
+        }
+        if(i == 0){
+            shell_print(sh, "  %7u us        %u", 0, counts[i]);
+        }else if(i == LOG_HIST_BUCKETS - 1){
+            shell_print(sh, "  %7u us and up %u", 1u << (i - 1), counts[i]);
+        }else{
+            shell_print(sh, "  %7u-%-7u us %u", 1u << (i - 1), (1u << i) - 1, counts[i]);
+        }
+    }
+}
+
+static int cmd_stats(const struct shell* sh, size_t argc, char** argv){
+    log_hist_print(sh, "frame render", &frame_render);
+    log_hist_print(sh, "frame jitter", &frame_jitter);
+    log_hist_print(sh, "event residency", &event_residency);
+    log_hist_print(sh, "remote command latency", &command_latency);
+    shell_print(sh, "deadline misses: %u", (uint32_t)atomic_get(&deadline_misses));
+    return 0;
+}
+
+static int cmd_stats_reset(const struct shell* sh, size_t argc, char** argv){
+    swstats_reset();
+    shell_print(sh, "stats reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_stopwatch_stats,
+    SHELL_CMD(reset, NULL, "Clear the histograms and counters", cmd_stats_reset),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_stopwatch,
+    SHELL_CMD(stats, &sub_stopwatch_stats, "Frame, button and remote latency histograms", cmd_stats),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(stopwatch, &sub_stopwatch, "Stopwatch commands", NULL);
+#endif
+
+#endif // CONFIG_STOPWATCH_STATS
@@ -0,0 +1,46 @@
+#ifndef SWSTATS_H
+#define SWSTATS_H
+
+#include <zephyr.h>
+
+const uint8_t LOG_HIST_BUCKETS = 20;
+
+/**
+ * @brief histogram with power of two buckets
+ *
+ * Bucket 0 counts 0 us, bucket b counts [2^(b-1), 2^b) us, the last one
+ * everything above. Adding is a single atomic increment, so it is safe
+ * from ISRs and any thread without a lock.
+ */
+struct log_hist{
+    atomic_t buckets[LOG_HIST_BUCKETS];
+    atomic_t max;
+};
+
+/*
+ * Always-on runtime statistics of the display and the button path, printed
+ * and reset with the "stopwatch stats" shell command.
+ *
+ * All values are in us. The frame jitter is how long after the timer expiry
+ * lcd_run() started drawing, a deadline miss is a refresh step of the running
+ * time that was never drawn because its frame started too late. The remote command latency
+ * runs from the arrival of a command byte until the stopwatch is in the new
+ * state.
+ */
+#ifdef CONFIG_STOPWATCH_STATS
+void log_hist_add(struct log_hist* hist, uint32_t value);
+void log_hist_reset(struct log_hist* hist);
+
+void swstats_frame(uint32_t jitter_cycles, uint32_t render_cycles, uint32_t missed);
+void swstats_event(uint32_t residency_cycles);
+void swstats_command(uint32_t latency_cycles);
+void swstats_reset(void);
+#else
+static inline void swstats_frame(uint32_t jitter_cycles, uint32_t render_cycles, uint32_t missed) {}
+static inline void swstats_event(uint32_t residency_cycles) {}
+static inline void swstats_command(uint32_t latency_cycles) {}
+static inline void swstats_reset(void) {}
+#endif
+
+
+#endif /*SWSTATS_H*/
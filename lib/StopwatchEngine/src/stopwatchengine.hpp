@@ -0,0 +1,137 @@
+#ifndef STOPWATCHENGINE_H
+#define STOPWATCHENGINE_H
+
+#include <zephyr.h>
+#include <timeformat.hpp>
+
+/**
+ * @brief timing core for N stopwatch channels, all on one time base
+ *
+ * Struct of arrays, one entry per channel. A running channel only stores its
+ * origin, the point on the time base where it would have been started had it
+ * never paused, so its time is now - origin and nothing has to be updated per
+ * channel when time moves on. tick() sets the shared now, start/pause/resume/lap
+ * touch one entry, all of them O(1). Formatting happens only in render(), for
+ * the channels that are on a display.
+ *
+ * All times in ticks (k_uptime_ticks()). Which transitions are allowed is up to
+ * the caller's StopwatchFSM.
+ *
+ * @tparam N number of channels
+ */
+template<uint16_t N>
+class StopwatchEngine{
+    public:
+        static constexpr uint16_t channels = N;
+
+        /**
+         * @brief move the shared time base, one store for every channel
+         *
+         * @param now ticks
+         */
+        void tick(int64_t now){
+            this->now = now;
+        }
+
+        /**
+         * @brief start a channel from zero
+         *
+         * @param ch channel
+         * @param timestamp ticks of the start
+         */
+        void start(uint16_t ch, int64_t timestamp){
+            this->origin[ch] = timestamp;
+            this->frozen[ch] = 0;
+            this->lap_mark[ch] = 0;
+            this->running[ch] = true;
+        }
+
+        /**
+         * @brief freeze a running channel
+         *
+         * @param ch channel
+         * @param timestamp ticks of the pause
+         */
+        void pause(uint16_t ch, int64_t timestamp){
+            this->frozen[ch] = timestamp - this->origin[ch];
+            this->running[ch] = false;
+        }
+
+        /**
+         * @brief continue a paused channel, the pause does not count
+         *
+         * @param ch channel
+         * @param timestamp ticks of the resume
+         */
+        void resume(uint16_t ch, int64_t timestamp){
+            this->origin[ch] = timestamp - this->frozen[ch];
+            this->running[ch] = true;
+        }
+
+        /**
+         * @brief take a lap
+         *
+         * @param ch channel
+         * @param timestamp ticks of the lap
+         * @return int64_t the lap duration, pauses during the lap not counted
+         */
+        int64_t lap(uint16_t ch, int64_t timestamp){
+            int64_t at = this->elapsed_at(ch, timestamp);
+            int64_t duration = at - this->lap_mark[ch];
+
+            this->lap_mark[ch] = at;
+            return duration;
+        }
+
+        /**
+         * @brief continue paused from a saved time
+         *
+         * @param ch channel
+         * @param elapsed ticks on the channel
+         * @param since_lap ticks since its last lap, or since the start
+         */
+        void restore(uint16_t ch, int64_t elapsed, int64_t since_lap){
+            this->frozen[ch] = elapsed;
+            this->lap_mark[ch] = elapsed - since_lap;
+            this->running[ch] = false;
+        }
+
+        /**
+         * @brief time on a channel at a point of the time base
+         *
+         * @param ch channel
+         * @param timestamp ticks, only matters while the channel runs
+         * @return int64_t ticks
+         */
+        int64_t elapsed_at(uint16_t ch, int64_t timestamp) const {
+            return this->running[ch] ? timestamp - this->origin[ch] : this->frozen[ch];
+        }
+
+        int64_t elapsed(uint16_t ch) const {return this->elapsed_at(ch, this->now);}
+        int64_t since_lap_at(uint16_t ch, int64_t timestamp) const {return this->elapsed_at(ch, timestamp) - this->lap_mark[ch];}
+        bool is_running(uint16_t ch) const {return this->running[ch];}
+
+        /**
+         * @brief format the time of the shown channels as "MM:SS:cc"
+         *
+         * @param shown the channels on the display
+         * @param count number of entries in shown and out
+         * @param out one TIMEFMT_LEN row per shown channel
+         */
+        void render(const uint16_t* shown, uint8_t count, char (*out)[TIMEFMT_LEN]) const {
+            for(uint8_t i = 0; i < count; i++){
+                int64_t ticks = this->elapsed(shown[i]);
+                timefmt_ms(out[i], (ticks > 0) ? (uint32_t)k_ticks_to_ms_floor64(ticks) : 0);
+            }
+        }
+
+    private:
+        int64_t now = 0;
+        int64_t origin[N] = {};     // running: the time base at which the channel read zero
+        int64_t frozen[N] = {};     // paused: the time on the channel
+        int64_t lap_mark[N] = {};   // time on the channel at the last lap
+        bool running[N] = {};
+};
+
+
+#endif /*STOPWATCHENGINE_H*/
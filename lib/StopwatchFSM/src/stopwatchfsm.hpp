@@ -0,0 +1,123 @@
+#ifndef STOPWATCHFSM_H
+#define STOPWATCHFSM_H
+
+#include <zephyr.h>
+#include <gesture.hpp>
+
+/**
+ * @brief The states of the stopwatch, shared by the display and the LEDs
+ * 
+ */
+enum states_sw{
+    SW_IDLE = 0,
+    SW_RUN,
+    SW_PAUSE,
+    SW_RESET,
+    SW_NUM_STATES
+};
+
+/**
+ * @brief What a transition asks the subsystems to do, each one picks the actions it cares about
+ * 
+ */
+enum sw_actions{
+    ACT_NONE = 0,
+    ACT_START = BIT(0),         // start timing from zero, clear the lap line
+    ACT_LAP = BIT(1),           // record and display a lap
+    ACT_PAUSE = BIT(2),         // freeze the time
+    ACT_RESUME = BIT(3),        // continue after a pause
+    ACT_LED0_ON = BIT(4),
+    ACT_LED1_ON = BIT(5),
+    ACT_LEDS_OFF = BIT(6),
+    ACT_LEDS_ON = BIT(7),
+};
+
+struct sw_transition{
+    uint8_t next;
+    uint16_t actions;
+    bool handled;   // only set by sw_to(), so a cell left out of the table fails the static_assert below
+};
+
+constexpr sw_transition sw_to(uint8_t next, uint16_t actions){
+    return sw_transition{next, actions, true};
+}
+
+/**
+ * @brief state x gesture -> next state + actions
+ * 
+ * Holding only drives the LEDs, the stopwatch changes when the button is released:
+ *  - short press: start, lap, or restart after a reset
+ *  - 2 s hold: pause / resume
+ *  - 4 s hold: reset while running
+ * 
+ * The keypad keys act on the key press, each does one thing: start/resume, lap, pause, reset.
+ */
+constexpr sw_transition SW_TRANSITIONS[SW_NUM_STATES][GESTURE_NUM_TYPES] = {
+    /*               PRESS                        HOLD_2S                         HOLD_4S                         RELEASE_SHORT                               RELEASE_LONG                                 RELEASE_VERY_LONG
+     *               KEY_START                                  KEY_LAP                                 KEY_PAUSE                                   KEY_RESET */
+    /* SW_IDLE  */ { sw_to(SW_IDLE, ACT_NONE),    sw_to(SW_IDLE, ACT_LED0_ON),    sw_to(SW_IDLE, ACT_LED1_ON),    sw_to(SW_RUN, ACT_START | ACT_LEDS_OFF),    sw_to(SW_IDLE, ACT_LEDS_ON),                 sw_to(SW_IDLE, ACT_LEDS_ON),
+                     sw_to(SW_RUN, ACT_START | ACT_LEDS_OFF),   sw_to(SW_IDLE, ACT_NONE),               sw_to(SW_IDLE, ACT_NONE),                   sw_to(SW_IDLE, ACT_NONE) },
+    /* SW_RUN   */ { sw_to(SW_RUN, ACT_NONE),     sw_to(SW_RUN, ACT_LED0_ON),     sw_to(SW_RUN, ACT_LED1_ON),     sw_to(SW_RUN, ACT_LAP | ACT_LEDS_OFF),      sw_to(SW_PAUSE, ACT_PAUSE | ACT_LEDS_OFF),   sw_to(SW_RESET, ACT_LEDS_ON),
+                     sw_to(SW_RUN, ACT_NONE),                   sw_to(SW_RUN, ACT_LAP | ACT_LEDS_OFF),  sw_to(SW_PAUSE, ACT_PAUSE | ACT_LEDS_OFF),  sw_to(SW_RESET, ACT_LEDS_ON) },
+    /* SW_PAUSE */ { sw_to(SW_PAUSE, ACT_NONE),   sw_to(SW_PAUSE, ACT_LED0_ON),   sw_to(SW_PAUSE, ACT_LED1_ON),   sw_to(SW_PAUSE, ACT_LEDS_OFF),              sw_to(SW_RUN, ACT_RESUME | ACT_LEDS_OFF),    sw_to(SW_PAUSE, ACT_LEDS_OFF),
+                     sw_to(SW_RUN, ACT_RESUME | ACT_LEDS_OFF),  sw_to(SW_PAUSE, ACT_NONE),              sw_to(SW_PAUSE, ACT_NONE),                  sw_to(SW_RESET, ACT_LEDS_ON) },
+    /* SW_RESET */ { sw_to(SW_RESET, ACT_NONE),   sw_to(SW_RESET, ACT_LED0_ON),   sw_to(SW_RESET, ACT_LED1_ON),   sw_to(SW_RUN, ACT_START | ACT_LEDS_OFF),    sw_to(SW_RESET, ACT_LEDS_ON),                sw_to(SW_RESET, ACT_LEDS_ON),
+                     sw_to(SW_RUN, ACT_START | ACT_LEDS_OFF),   sw_to(SW_RESET, ACT_NONE),              sw_to(SW_RESET, ACT_NONE),                  sw_to(SW_RESET, ACT_NONE) },
+};
+
+/* every pair is handled and leads to a valid state */
+constexpr bool sw_table_complete(size_t i = 0){
+    return (i >= SW_NUM_STATES * GESTURE_NUM_TYPES) ? true :
+        (SW_TRANSITIONS[i / GESTURE_NUM_TYPES][i % GESTURE_NUM_TYPES].handled &&
+         SW_TRANSITIONS[i / GESTURE_NUM_TYPES][i % GESTURE_NUM_TYPES].next < SW_NUM_STATES &&
+         sw_table_complete(i + 1));
+}
+
+/* the button is still down for PRESS/HOLD, those may not change the state */
+constexpr bool sw_holds_keep_state(size_t state = 0){
+    return (state >= SW_NUM_STATES) ? true :
+        (SW_TRANSITIONS[state][GESTURE_PRESS].next == state &&
+         SW_TRANSITIONS[state][GESTURE_HOLD_2S].next == state &&
+         SW_TRANSITIONS[state][GESTURE_HOLD_4S].next == state &&
+         sw_holds_keep_state(state + 1));
+}
+
+static_assert(sw_table_complete(), "SW_TRANSITIONS has an unhandled state/gesture pair");
+static_assert(sw_holds_keep_state(), "SW_TRANSITIONS changes state while the button is still held");
+
+
+/**
+ * @brief the stopwatch state machine, one per subsystem, all driven by the same table
+ * 
+ */
+class StopwatchFSM{
+    public:
+        /**
+         * @brief take the transition for a gesture
+         * 
+         * @param gesture gesture_type
+         * @return uint16_t the sw_actions of the transition
+         */
+        uint16_t dispatch(uint8_t gesture){
+            if(gesture >= GESTURE_NUM_TYPES){
+                return ACT_NONE;
+            }
+            const sw_transition& transition = SW_TRANSITIONS[this->state][gesture];
+            this->state = transition.next;
+            return transition.actions;
+        }
+
+        /**
+         * @brief continue from a state saved before a reset
+         * 
+         * @param saved the saved state, a session that was running comes back paused
+         */
+        void restore(uint8_t saved){
+            this->state = (saved == SW_RUN || saved == SW_PAUSE) ? SW_PAUSE : SW_IDLE;
+        }
+
+        uint8_t state = SW_IDLE;
+};
+
+
+#endif /*STOPWATCHFSM_H*/
@@ -0,0 +1,273 @@
+/**
+ * @file telemetry.cpp
+ * @brief Framed binary lap telemetry on a UART, double buffered through the async UART API
+ * @version 0.1
+ *
+ *
+ */
+
+#include "telemetry.hpp"
+
+#ifdef CONFIG_STOPWATCH_TELEMETRY
+
+#include <device.h>
+#include <devicetree.h>
+#include <drivers/uart.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+
+#define TELEMETRY_BUFFER_LEN (CONFIG_STOPWATCH_TELEMETRY_BUFFER_RECORDS * TELEMETRY_RECORD_LEN)
+
+static const struct device* uart_dev = DEVICE_DT_GET(DT_CHOSEN(stopwatch_telemetry_uart));
+
+/* polls buffers out when there is no async API, a whole one blocks for tens of ms */
+K_THREAD_STACK_DEFINE(telemetry_poll_stack, CONFIG_STOPWATCH_TELEMETRY_POLL_STACK_SIZE);
+static struct k_work_q telemetry_poll_queue;
+
+struct telemetry_buffer{
+    uint8_t data[TELEMETRY_BUFFER_LEN];
+    size_t len;
+};
+
+/* the buffer being filled and the one on the wire, swapped when a transfer is done */
+static struct{
+    struct k_spinlock lock;
+    struct telemetry_buffer buffers[2];
+    uint8_t filling;
+    bool sending;
+    uint32_t seq;
+    struct telemetry_stats stats;
+    struct k_work poll_work;
+    bool ready;         // set by telemetry_init(), records before that are ignored
+} telemetry;
+
+
+/**
+ * @brief put the filled buffer on the wire if the UART is free, called with the lock held
+ *
+ * @return struct telemetry_buffer* the buffer to send, NULL if there is nothing or the UART is busy
+ */
+static struct telemetry_buffer* telemetry_swap(void){
+    struct telemetry_buffer* buffer = &telemetry.buffers[telemetry.filling];
+
+    if(telemetry.sending || buffer->len == 0){
+        return NULL;
+    }
+    telemetry.sending = true;
+    telemetry.filling ^= 1;
+    telemetry.buffers[telemetry.filling].len = 0;
+    telemetry.stats.transfers++;
+    return buffer;
+}
+
+/**
+ * @brief start a transfer, outside the lock
+ *
+ * @param buffer from telemetry_swap(), or NULL
+ *
+ * Without the async API, or if the driver turns it down, the buffer is polled
+ * out from a low priority workqueue of its own instead, so nothing else waits for
+ * the bytes to be clocked out.
+ */
+static void telemetry_send(struct telemetry_buffer* buffer){
+    if(buffer == NULL){
+        return;
+    }
+#ifdef CONFIG_UART_ASYNC_API
+    if(telemetry.stats.async){
+        int rc = uart_tx(uart_dev, buffer->data, buffer->len, SYS_FOREVER_MS);
+        if(rc == 0){
+            return;
+        }
+        // e.g. -ENOTSUP when the UART has no DMA channel in the devicetree
+        printk("Telemetry: uart_tx failed: %d, polling from now on\n", rc);
+        telemetry.stats.async = false;
+    }
+#endif
+    k_work_submit_to_queue(&telemetry_poll_queue, &telemetry.poll_work);
+}
+
+/**
+ * @brief the buffer on the wire is out, send the other one if it has records
+ *
+ */
+static void telemetry_tx_done(void){
+    k_spinlock_key_t key = k_spin_lock(&telemetry.lock);
+    telemetry.sending = false;
+    struct telemetry_buffer* next = telemetry_swap();
+    k_spin_unlock(&telemetry.lock, key);
+
+    telemetry_send(next);
+}
+
+/**
+ * @brief work handler, writes the buffer on the wire byte by byte when there is no async API
+ *
+ */
+static void telemetry_poll_out(struct k_work* work){
+    const struct telemetry_buffer* buffer = &telemetry.buffers[telemetry.filling ^ 1];
+
+    for(size_t i = 0; i < buffer->len; i++){
+        uart_poll_out(uart_dev, buffer->data[i]);
+    }
+    telemetry_tx_done();
+}
+
+#ifdef CONFIG_UART_ASYNC_API
+/**
+ * @brief async UART callback, called from the UART (or DMA) interrupt
+ *
+ */
+static void telemetry_uart_cb(const struct device* dev, struct uart_event* evt, void* user_data){
+    switch(evt->type){
+    case UART_TX_DONE:
+    case UART_TX_ABORTED:
+        telemetry_tx_done();
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+/**
+ * @brief frame one record into the filling buffer and send it if the UART is idle
+ *
+ * @param type telemetry_type
+ * @param state states_sw after the event
+ * @param timestamp ticks (k_uptime_ticks()) of the event
+ * @param value_us see telemetry_type
+ *
+ * Callable from any context, a full buffer drops the record.
+ */
+static void telemetry_record(uint8_t type, uint8_t state, int64_t timestamp, uint64_t value_us){
+    if(!telemetry.ready){
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&telemetry.lock);
+    struct telemetry_buffer* buffer = &telemetry.buffers[telemetry.filling];
+    uint32_t seq = telemetry.seq++;
+
+    if(buffer->len + TELEMETRY_RECORD_LEN > sizeof(buffer->data)){
+        telemetry.stats.dropped++;
+        k_spin_unlock(&telemetry.lock, key);
+        return;
+    }
+
+    uint8_t* record = &buffer->data[buffer->len];
+    record[0] = TELEMETRY_SYNC0;
+    record[1] = TELEMETRY_SYNC1;
+    record[2] = type;
+    record[3] = state;
+    sys_put_le32(seq, &record[4]);
+    sys_put_le64((timestamp > 0) ? k_ticks_to_us_floor64(timestamp) : 0, &record[8]);
+    sys_put_le64(value_us, &record[16]);
+    sys_put_le16(crc16_ccitt(0xffff, &record[2], 22), &record[24]);
+    buffer->len += TELEMETRY_RECORD_LEN;
+    telemetry.stats.records++;
+
+    struct telemetry_buffer* ready = telemetry_swap();
+    k_spin_unlock(&telemetry.lock, key);
+
+    telemetry_send(ready);
+}
+
+/**
+ * @brief set up the UART
+ *
+ * @return int 0 on success, negative errno otherwise
+ */
+int telemetry_init(void){
+    if(!device_is_ready(uart_dev)){
+        return -ENODEV;
+    }
+
+    const struct k_work_queue_config poll_config = {.name = "telemetry_poll", .no_yield = false};
+
+    // started even with the async API, uart_tx() may still turn a transfer down
+    k_work_queue_start(&telemetry_poll_queue, telemetry_poll_stack, K_THREAD_STACK_SIZEOF(telemetry_poll_stack),
+                       CONFIG_STOPWATCH_TELEMETRY_POLL_PRIORITY, &poll_config);
+    k_work_init(&telemetry.poll_work, telemetry_poll_out);
+#ifdef CONFIG_UART_ASYNC_API
+    int rc = uart_callback_set(uart_dev, telemetry_uart_cb, NULL);
+    telemetry.stats.async = (rc == 0);
+#endif
+    telemetry.ready = true;
+
+    printk("Telemetry on %s (%s)\n", uart_dev->name, telemetry.stats.async ? "async" : "polled");
+    return 0;
+}
+
+/**
+ * @brief report a state change
+ *
+ * @param state the new states_sw
+ * @param timestamp ticks of the edge that caused it
+ * @param elapsed ticks on the stopwatch at that point
+ */
+void telemetry_state(uint8_t state, int64_t timestamp, int64_t elapsed){
+    telemetry_record(TELEMETRY_STATE, state, timestamp, (elapsed > 0) ? k_ticks_to_us_floor64(elapsed) : 0);
+}
+
+/**
+ * @brief report a lap
+ *
+ * @param state states_sw the lap was taken in
+ * @param timestamp ticks of the edge that took the lap
+ * @param duration lap duration in ticks
+ */
+void telemetry_lap(uint8_t state, int64_t timestamp, int64_t duration){
+    telemetry_record(TELEMETRY_LAP, state, timestamp, (duration > 0) ? k_ticks_to_us_floor64(duration) : 0);
+}
+
+/**
+ * @brief the transmit counters since boot
+ *
+ * @param stats receives the counters
+ */
+void telemetry_stats(struct telemetry_stats* stats){
+    k_spinlock_key_t key = k_spin_lock(&telemetry.lock);
+    *stats = telemetry.stats;
+    k_spin_unlock(&telemetry.lock, key);
+}
+
+
+#ifdef CONFIG_SHELL
+#include <shell/shell.h>
+#include <stdlib.h>
+
+/**
+ * @brief "telemetry flood <n>": queue n test records as fast as possible
+ *
+ * Throughput check for scripts/telemetry_decode.py, whatever does not fit is dropped.
+ */
+static int cmd_telemetry_flood(const struct shell* sh, size_t argc, char** argv){
+    uint32_t count = strtoul(argv[1], NULL, 0);
+
+    for(uint32_t i = 0; i < count; i++){
+        telemetry_record(TELEMETRY_TEST, 0, k_uptime_ticks(), i);
+        k_yield();
+    }
+    return 0;
+}
+
+static int cmd_telemetry_stats(const struct shell* sh, size_t argc, char** argv){
+    struct telemetry_stats stats;
+
+    telemetry_stats(&stats);
+    shell_print(sh, "records %u dropped %u transfers %u (%s)", stats.records, stats.dropped,
+                stats.transfers, stats.async ? "async" : "polled");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_telemetry,
+    SHELL_CMD_ARG(flood, NULL, "Queue <n> test records", cmd_telemetry_flood, 2, 0),
+    SHELL_CMD(stats, NULL, "Records sent and dropped", cmd_telemetry_stats),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(telemetry, &sub_telemetry, "Lap telemetry stream", NULL);
+#endif
+
+#endif // CONFIG_STOPWATCH_TELEMETRY
@@ -0,0 +1,66 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <zephyr.h>
+
+/**
+ * @brief what a telemetry record reports
+ *
+ */
+enum telemetry_type{
+    TELEMETRY_STATE = 1,    // the stopwatch changed state, value is the time on the stopwatch
+    TELEMETRY_LAP,          // a lap was taken, value is its duration
+    TELEMETRY_TEST,         // filler from "telemetry flood", value is its index
+};
+
+/*
+ * Record on the wire, little endian, 26 bytes:
+ *
+ *   0  sync        0xa5 0x5a
+ *   2  type        telemetry_type
+ *   3  state       states_sw after the event
+ *   4  seq         u32, +1 per record, also for the ones dropped on overflow
+ *   8  timestamp   u64, us since boot of the button edge or key sample
+ *  16  value       u64 us, see telemetry_type
+ *  24  crc         u16, crc16_ccitt(0xffff) over bytes 2..23
+ *
+ * scripts/telemetry_decode.py decodes it on the host.
+ */
+const uint8_t TELEMETRY_SYNC0 = 0xa5;
+const uint8_t TELEMETRY_SYNC1 = 0x5a;
+const uint8_t TELEMETRY_RECORD_LEN = 26;
+
+/**
+ * @brief transmit counters since boot
+ *
+ */
+struct telemetry_stats{
+    uint32_t records;       // handed to the UART
+    uint32_t dropped;       // did not fit in the buffer
+    uint32_t transfers;     // buffers sent
+    bool async;             // false if the UART has no async API and bytes are polled out
+};
+
+/*
+ * Binary stream of state changes and laps on the UART chosen as
+ * stopwatch,telemetry-uart.
+ *
+ * Records are appended to one of two buffers while the other one is on the
+ * wire through uart_tx(). When a transfer is done the buffers swap from the
+ * UART callback, so records never wait for the UART and the UART never waits
+ * for a thread. If the buffer fills up because the host reads too slowly,
+ * further records are dropped and counted, the caller is never blocked.
+ */
+#ifdef CONFIG_STOPWATCH_TELEMETRY
+int telemetry_init(void);
+void telemetry_state(uint8_t state, int64_t timestamp, int64_t elapsed);
+void telemetry_lap(uint8_t state, int64_t timestamp, int64_t duration);
+void telemetry_stats(struct telemetry_stats* stats);
+#else
+static inline int telemetry_init(void) {return -ENOTSUP;}
+static inline void telemetry_state(uint8_t state, int64_t timestamp, int64_t elapsed) {}
+static inline void telemetry_lap(uint8_t state, int64_t timestamp, int64_t duration) {}
+#endif
+
+
+#endif /*TELEMETRY_H*/
@@ -1,125 +1,453 @@
 #include "hd44780.h"
+#include "hd44780_transport.h"
+#include <errno.h>
+#ifdef CONFIG_HD44780_VIRTUAL
+#include "hd44780_virtual.h"
+#endif
 
-static struct hd44780_display disp = {
-    .pin_dt[D4] = HD44780_PIN_D4,
-    .pin_dt[D5] = HD44780_PIN_D5,
-    .pin_dt[D6] = HD44780_PIN_D6,
-    .pin_dt[D7] = HD44780_PIN_D7,
-    .pin_dt[RS] = HD44780_PIN_RS,
-    .pin_dt[EN] = HD44780_PIN_EN,
-};
+static struct hd44780_display disp = HD44780_DT_DISPLAY(HD44780_NODE);
 
 static inline void
-hd44780_pulse()
+hd44780_pulse(struct hd44780_display *d)
 {
     // en
-    gpio_pin_set_dt(&(disp.pin_dt[EN]), 1);
-    // ds says min 1 us, but only 1000 works reliably
-    k_usleep(1000);
+    gpio_pin_set_dt(&(d->pin_dt[EN]), 1);
+#ifdef CONFIG_HD44780_VIRTUAL
+    hd44780_virtual_en(d, 1);
+#endif
+    // PW_EH min 450 ns
+    hd44780_spin(d->timing.en_pulse);
     // dis
-    gpio_pin_set_dt(&(disp.pin_dt[EN]), 0);
+    gpio_pin_set_dt(&(d->pin_dt[EN]), 0);
+#ifdef CONFIG_HD44780_VIRTUAL
+    // the controller latches on the falling edge
+    hd44780_virtual_en(d, 0);
+#endif
+    // t_cycE min 1000 ns, so keep EN low at least as long as it was high
+    hd44780_spin(d->timing.en_pulse);
+}
+
+/*
+ * D4-D7 are written with a single gpio_port_set_masked_raw() when they share
+ * a port. The raw port value for every nibble is precomputed in
+ * hd44780_bus_setup(), which covers any pin order and active-low pins.
+ */
+static void
+hd44780_bus_setup(struct hd44780_display *d)
+{
+    struct hd44780_bus *bus = &d->bus;
+    uint32_t n, i;
+
+    bus->port = d->pin_dt[D4].port;
+    bus->mask = 0;
+    bus->masked = true;
+
+    for (i = D4; i <= D7; i++)
+    {
+        if (d->pin_dt[i].port != bus->port)
+        {
+            bus->masked = false;
+            return;
+        }
+        bus->mask |= BIT(d->pin_dt[i].pin);
+    }
+
+    for (n = 0; n < 16; n++)
+    {
+        bus->lut[n] = 0;
+        for (i = D4; i <= D7; i++)
+        {
+            bool level = (n & BIT(i - D4)) != 0;
+
+            if (d->pin_dt[i].dt_flags & GPIO_ACTIVE_LOW)
+                level = !level;
+            if (level)
+                bus->lut[n] |= BIT(d->pin_dt[i].pin);
+        }
+    }
 }
 
 static inline void
-hd44780_nibble(uint8_t n)
+hd44780_put_nibble(struct hd44780_display *d, uint8_t n)
+{
+    if (d->bus.masked)
+    {
+        gpio_port_set_masked_raw(d->bus.port, d->bus.mask, d->bus.lut[n & 0x0f]);
+        return;
+    }
+    // pins split across ports
+    gpio_pin_set_dt(&(d->pin_dt[D7]), (n & (1 << 3)) ? 1 : 0);
+    gpio_pin_set_dt(&(d->pin_dt[D6]), (n & (1 << 2)) ? 1 : 0);
+    gpio_pin_set_dt(&(d->pin_dt[D5]), (n & (1 << 1)) ? 1 : 0);
+    gpio_pin_set_dt(&(d->pin_dt[D4]), (n & (1 << 0)) ? 1 : 0);
+}
+
+static void
+hd44780_nibble(struct hd44780_display *d, uint8_t n)
 {
-    gpio_pin_set_dt(&(disp.pin_dt[RS]), 0); //cmd
-    gpio_pin_set_dt(&(disp.pin_dt[D7]), (n & (1 << 7)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D6]), (n & (1 << 6)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D5]), (n & (1 << 5)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D4]), (n & (1 << 4)) ? 1 : 0);
-    hd44780_pulse();
+    hd44780_wait_ready(d);
+    gpio_pin_set_dt(&(d->pin_dt[RS]), 0); //cmd
+    hd44780_put_nibble(d, n >> 4);
+    hd44780_pulse(d);
 }
 
 static void
-hd44780_byte(uint8_t b)
+hd44780_byte(struct hd44780_display *d, uint8_t b, uint32_t exec_cycles)
 {
     // high nibble
-    gpio_pin_set_dt(&(disp.pin_dt[D7]), (b & (1 << 7)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D6]), (b & (1 << 6)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D5]), (b & (1 << 5)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D4]), (b & (1 << 4)) ? 1 : 0);
-    hd44780_pulse();
+    hd44780_put_nibble(d, b >> 4);
+    hd44780_pulse(d);
     // low nibble
-    gpio_pin_set_dt(&(disp.pin_dt[D7]), (b & (1 << 3)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D6]), (b & (1 << 2)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D5]), (b & (1 << 1)) ? 1 : 0);
-    gpio_pin_set_dt(&(disp.pin_dt[D4]), (b & (1 << 0)) ? 1 : 0);
-    hd44780_pulse();
+    hd44780_put_nibble(d, b);
+    hd44780_pulse(d);
+
+    hd44780_set_busy(d, exec_cycles);
+}
+
+static void
+hd44780_gpio_write(struct hd44780_display *d, const uint16_t *entries, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        hd44780_wait_ready(d);
+        // rs high - data, low - command
+        gpio_pin_set_dt(&(d->pin_dt[RS]), (entries[i] & HD44780_ENTRY_RS) ? 1 : 0);
+        hd44780_byte(d, (uint8_t)entries[i], hd44780_entry_exec(d, entries[i]));
+    }
+}
+
+static int
+hd44780_gpio_setup(struct hd44780_display *d)
+{
+    uint32_t i;
+    int rc = 0;
+
+    hd44780_bus_setup(d);
+
+    for(i = 0; i < PINS_MAX; i++)
+    {
+        int res = gpio_pin_configure_dt(&(d->pin_dt[i]), GPIO_OUTPUT);
+        if (res != 0)
+        {
+            printk("HD44780: Failed to configure pin %u: %d\n", i, res);
+            rc = res;
+        }
+    }
+    return rc;
+}
+
+const struct hd44780_transport hd44780_gpio_transport = {
+    .setup = hd44780_gpio_setup,
+    .nibble = hd44780_nibble,
+    .write = hd44780_gpio_write,
+    // every byte is waited out anyway, keep ring slots free as early as possible
+    .batch = 1,
+    .name = "gpio",
+};
+
+void
+hd44780_display_entries(struct hd44780_display *d, const uint16_t *entries, size_t count)
+{
+    d->transport->write(d, entries, count);
+}
+
+void
+hd44780_display_data(struct hd44780_display *d, char val)
+{
+    uint16_t entry = HD44780_ENTRY_DATA(val);
+
+    d->transport->write(d, &entry, 1);
+}
+
+void
+hd44780_display_cmd(struct hd44780_display *d, uint8_t cmd, uint8_t flags)
+{
+    uint16_t entry = cmd | flags;
+
+    d->transport->write(d, &entry, 1);
+}
+
+void
+hd44780_display_write(struct hd44780_display *d, uint8_t addr, const char *str, uint8_t len)
+{
+    uint16_t entries[1 + HD44780_DDRAM_LINE];
+    uint8_t i;
+
+    len = MIN(len, HD44780_DDRAM_LINE);
+    entries[0] = HD44780_CMD_DDRAM | addr;
+    for (i = 0; i < len; i++)
+        entries[1 + i] = HD44780_ENTRY_DATA(str[i]);
 
-    // most commands take about 37 us, 1000 to be safe
-    k_usleep(10000);
+    d->transport->write(d, entries, 1 + len);
+}
+
+void
+hd44780_display_wait(struct hd44780_display *d)
+{
+    hd44780_wait_ready(d);
 }
 
 void
 hd44780_data(char val)
 {
-    // rs high - data
-    gpio_pin_set_dt(&(disp.pin_dt[RS]), 1);
-    hd44780_byte(val);
+    hd44780_display_data(&disp, val);
 }
 
 void
 hd44780_cmd(uint8_t cmd, uint8_t flags)
 {
-    cmd |= flags;
-    // rs low - command
-    gpio_pin_set_dt(&(disp.pin_dt[RS]), 0);
-    hd44780_byte(cmd);
+    hd44780_display_cmd(&disp, cmd, flags);
+}
+
+/* rows 2 and 3 of a 4 line display continue the DDRAM lines of rows 0 and 1 */
+static int
+hd44780_addr(uint8_t row, uint8_t col)
+{
+    if (row >= disp.rows || col >= disp.cols)
+        return -EINVAL;
+
+    return ((row & 1) ? 0x40 : 0x00) + ((row & 2) ? disp.cols : 0) + col;
 }
 
 void
 hd44780_pos(uint8_t row, uint8_t col)
 {
-    uint8_t addr;
+    int addr = hd44780_addr(row, col);
+
+    if (addr < 0)
+        return;
+
+    hd44780_cmd(HD44780_CMD_DDRAM, addr);
+}
+
+#ifdef CONFIG_HD44780_ASYNC
+
+#define RING_SIZE CONFIG_HD44780_ASYNC_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
+BUILD_ASSERT((RING_SIZE & RING_MASK) == 0, "HD44780 ring size must be a power of two");
+
+static uint16_t ring[RING_SIZE];
+// head only written by the producer, tail only by the writer thread
+static atomic_t ring_head;
+static atomic_t ring_tail;
+static atomic_t ring_high_water;
+static atomic_t ring_dropped;
+
+K_SEM_DEFINE(ring_data_sem, 0, 1);
+K_SEM_DEFINE(ring_idle_sem, 0, 1);
+
+static int
+hd44780_push(uint16_t entry)
+{
+    atomic_val_t head = atomic_get(&ring_head);
+    uint32_t used = (uint32_t)(head - atomic_get(&ring_tail));
 
-    switch (row)
+    if (used >= RING_SIZE)
     {
-        case 0:
-            addr = 0x00;
-            break;
-        case 1:
-            addr = 0x40;
-            break;
-        default:
-            return;
+        atomic_inc(&ring_dropped);
+        return -ENOSPC;
     }
 
-    if (col < 16)
-        addr += col;
-    else
-        return;
+    ring[head & RING_MASK] = entry;
+    // atomic_set is a full barrier, so the entry is visible before the new head
+    atomic_set(&ring_head, head + 1);
 
-    hd44780_cmd(HD44780_CMD_DDRAM, addr);
+    if (used + 1 > (uint32_t)atomic_get(&ring_high_water))
+        atomic_set(&ring_high_water, used + 1);
+
+    k_sem_give(&ring_data_sem);
+    return 0;
+}
+
+int
+hd44780_async_data(char val)
+{
+    return hd44780_push(HD44780_ENTRY_DATA(val));
+}
+
+int
+hd44780_async_cmd(uint8_t cmd, uint8_t flags)
+{
+    return hd44780_push(cmd | flags);
+}
+
+int
+hd44780_async_pos(uint8_t row, uint8_t col)
+{
+    int addr = hd44780_addr(row, col);
+
+    if (addr < 0)
+        return addr;
+
+    return hd44780_push(HD44780_CMD_DDRAM | addr);
+}
+
+uint32_t
+hd44780_async_space(void)
+{
+    return RING_SIZE - (uint32_t)(atomic_get(&ring_head) - atomic_get(&ring_tail));
+}
+
+uint32_t
+hd44780_async_high_water(void)
+{
+    return atomic_get(&ring_high_water);
+}
+
+uint32_t
+hd44780_async_dropped(void)
+{
+    return atomic_get(&ring_dropped);
 }
 
 void
-hd44780_init()
+hd44780_flush(void)
 {
-    uint32_t i;
+    // the writer gives idle every time it runs dry; a stale give just loops once more
+    while (atomic_get(&ring_head) != atomic_get(&ring_tail) || disp.timing.busy)
+    {
+        k_sem_take(&ring_idle_sem, K_FOREVER);
+    }
+}
 
-    for(i = 0; i < PINS_MAX; i++)
+static void
+hd44780_writer(void *unused0, void *unused1, void *unused2)
+{
+    while (true)
     {
-        int res = gpio_pin_configure_dt(&(disp.pin_dt[i]), GPIO_OUTPUT);
-        if (res != 0)
+        k_sem_take(&ring_data_sem, K_FOREVER);
+
+        atomic_val_t tail = atomic_get(&ring_tail);
+        atomic_val_t head;
+        while (tail != (head = atomic_get(&ring_head)))
         {
-            printk("HD44780: Failed to configure pin %u: %d\n", i, res);
+            // whatever is queued, up to the end of the ring, in one go: a frame
+            // is a single transaction on transports that batch
+            uint32_t count = MIN((uint32_t)(head - tail), RING_SIZE - (uint32_t)(tail & RING_MASK));
+
+            count = MIN(count, disp.transport->batch);
+            disp.transport->write(&disp, &ring[tail & RING_MASK], count);
+
+            tail += count;
+            atomic_set(&ring_tail, tail);
         }
+
+        hd44780_wait_ready(&disp);
+        k_sem_give(&ring_idle_sem);
+    }
+}
+
+K_THREAD_DEFINE(hd44780_writer_tid, CONFIG_HD44780_ASYNC_STACK_SIZE,
+                hd44780_writer, NULL, NULL, NULL,
+                CONFIG_HD44780_ASYNC_PRIORITY, 0, 0);
+
+#endif // CONFIG_HD44780_ASYNC
+
+#ifdef CONFIG_HD44780_BENCHMARK
+/*
+ * Bus cost of one data byte (nibbles + EN pulses, without the execution
+ * time), once with per-pin writes and once port-masked if available.
+ * Writes garbage to DDRAM, hd44780_init() clears it again afterwards.
+ */
+static uint32_t
+hd44780_bench_bytes()
+{
+    uint32_t i, cycles = 0;
+
+    gpio_pin_set_dt(&(disp.pin_dt[RS]), 1);
+    for (i = 0; i < CONFIG_HD44780_BENCHMARK_BYTES; i++)
+    {
+        hd44780_wait_ready(&disp);
+        uint32_t start = k_cycle_get_32();
+        hd44780_byte(&disp, (uint8_t)i, disp.timing.exec);
+        cycles += k_cycle_get_32() - start;
+    }
+    hd44780_wait_ready(&disp);
+
+    return cycles / CONFIG_HD44780_BENCHMARK_BYTES;
+}
+
+static void
+hd44780_bench()
+{
+    bool masked = disp.bus.masked;
+
+    disp.bus.masked = false;
+    uint32_t per_pin = hd44780_bench_bytes();
+    disp.bus.masked = masked;
+    uint32_t current = hd44780_bench_bytes();
+
+    printk("HD44780: byte cost per-pin %u ns, %s %u ns\n",
+           k_cyc_to_ns_floor32(per_pin),
+           masked ? "masked" : "masked n/a, per-pin",
+           k_cyc_to_ns_floor32(current));
+}
+#endif
+
+void
+hd44780_display_init(struct hd44780_display *d)
+{
+    d->timing.en_pulse = k_ns_to_cyc_ceil32(CONFIG_HD44780_EN_PULSE_NS);
+    d->timing.exec = k_us_to_cyc_ceil32(CONFIG_HD44780_EXEC_TIME_US);
+    d->timing.exec_long = k_us_to_cyc_ceil32(CONFIG_HD44780_CLEAR_TIME_US);
+    d->timing.sleep_threshold = k_us_to_cyc_ceil32(CONFIG_HD44780_SLEEP_THRESHOLD_US);
+    d->timing.busy = false;
+
+    int rc = d->transport->setup(d);
+    if (rc != 0)
+    {
+        printk("HD44780: %s setup failed: %d\n", d->transport->name, rc);
     }
-    
-    // display starts in 8 bit mode, so first command must pulse enable only once
-    // _nibble will do this using only high nibble, though only bus width can be set
-    hd44780_nibble(HD44780_CMD_CONFIG | HD44780_CONFIG_DATA4 );
-    // this command is long
-    k_sleep(K_MSEC(10));
 
-    // Display 16x2, Font 5x8
-    hd44780_cmd(HD44780_CMD_CONFIG, HD44780_CONFIG_2LINES|HD44780_CONFIG_5X8|HD44780_CONFIG_DATA4);
-    k_sleep(K_MSEC(10));
 
+    // the controller needs 40 ms after Vcc reaches 2.7 V. counted from boot,
+    // so whatever ran before us already paid for (part of) it
+    k_sleep(K_TIMEOUT_ABS_MS(CONFIG_HD44780_POWER_ON_MS));
+
+    // initialisation by instruction: three 8 bit function sets get the controller
+    // into 8 bit mode from any state, even halfway through a 4 bit byte.
+    // only the high nibble is wired, so each is a single EN pulse
+    d->transport->nibble(d, HD44780_CMD_CONFIG | HD44780_CONFIG_DATA8);
+    hd44780_set_busy(d, k_us_to_cyc_ceil32(4100));
+    d->transport->nibble(d, HD44780_CMD_CONFIG | HD44780_CONFIG_DATA8);
+    hd44780_set_busy(d, k_us_to_cyc_ceil32(100));
+    d->transport->nibble(d, HD44780_CMD_CONFIG | HD44780_CONFIG_DATA8);
+    hd44780_set_busy(d, d->timing.exec);
+    d->transport->nibble(d, HD44780_CMD_CONFIG | HD44780_CONFIG_DATA4);
+    hd44780_set_busy(d, d->timing.exec);
+
+    // 4 line modules are 2 line controllers with each line split in two. Font 5x8
+    hd44780_display_cmd(d, HD44780_CMD_CONFIG,
+                        ((d->rows > 1) ? HD44780_CONFIG_2LINES : HD44780_CONFIG_1LINE0) |
+                        HD44780_CONFIG_5X8 | HD44780_CONFIG_DATA4);
+    hd44780_display_cmd(d, HD44780_CMD_ONOFF, HD44780_ONOFF_DISP_OFF);
+    hd44780_display_cmd(d, HD44780_CMD_CLEAR, 0);
+    hd44780_display_cmd(d, HD44780_CMD_MODE, HD44780_MODE_INC);
     // On
-    hd44780_cmd(HD44780_CMD_ONOFF, HD44780_ONOFF_DISP_ON);
-    k_sleep(K_MSEC(10));
+    hd44780_display_cmd(d, HD44780_CMD_ONOFF, HD44780_ONOFF_DISP_ON);
+
+    if (d->transport == &hd44780_gpio_transport)
+        printk("HD44780 %ux%u init done (%s nibble writes)\n", d->cols, d->rows,
+               d->bus.masked ? "port-masked" : "per-pin");
+    else
+        printk("HD44780 %ux%u init done (%s)\n", d->cols, d->rows, d->transport->name);
+}
+
+void
+hd44780_init()
+{
+    hd44780_display_init(&disp);
 
-    printk("HD44780 init done\n");
+#ifdef CONFIG_HD44780_BENCHMARK
+    // the comparison is between two ways of driving the GPIOs
+    if (disp.transport == &hd44780_gpio_transport)
+    {
+        hd44780_bench();
+        // the bench left bytes in DDRAM and moved the address, callers
+        // rely on init leaving spaces everywhere and the address at 0
+        hd44780_display_cmd(&disp, HD44780_CMD_CLEAR, 0);
+    }
+#endif
 }
@@ -22,12 +22,47 @@ extern "C" {
  *  D9  EN
  */
 
-#define HD44780_PIN_D4 GPIO_DT_SPEC_GET(DT_NODELABEL(hd44780_pin_d4), gpios)
-#define HD44780_PIN_D5 GPIO_DT_SPEC_GET(DT_ALIAS(dfr0009d5), gpios)
-#define HD44780_PIN_D6 GPIO_DT_SPEC_GET(DT_ALIAS(dfr0009d6), gpios)
-#define HD44780_PIN_D7 GPIO_DT_SPEC_GET(DT_ALIAS(dfr0009d7), gpios)
-#define HD44780_PIN_RS GPIO_DT_SPEC_GET(DT_ALIAS(dfr0009rs), gpios)
-#define HD44780_PIN_EN GPIO_DT_SPEC_GET(DT_ALIAS(dfr0009en), gpios)
+/* the display behind the hd44780_*() calls, the chosen stopwatch,display if there is one */
+#if DT_HAS_CHOSEN(stopwatch_display)
+#define HD44780_NODE DT_CHOSEN(stopwatch_display)
+#else
+#define HD44780_NODE DT_NODELABEL(dfr0009)
+#endif
+
+/* Geometry is the columns and rows properties of the node, see
+ * hd44780-geometry.yaml. The pins are the pin_d4 .. pin_en children, unless
+ * the node is a "hd44780-pcf8574" I2C backpack. */
+#define HD44780_DT_COLS(node_id) DT_PROP(node_id, columns)
+#define HD44780_DT_ROWS(node_id) DT_PROP(node_id, rows)
+#define HD44780_DT_PIN(node_id, name) GPIO_DT_SPEC_GET(DT_CHILD(node_id, name), gpios)
+
+/* initializer of a struct hd44780_display for a devicetree node, positional so it also works in C++ */
+#define HD44780_DT_DISPLAY(node_id)                                                   \
+    COND_CODE_1(DT_NODE_HAS_COMPAT(node_id, hd44780_pcf8574),                         \
+                (HD44780_DT_DISPLAY_PCF8574(node_id)),                                \
+                (HD44780_DT_DISPLAY_GPIO(node_id)))
+
+#define HD44780_DT_DISPLAY_GPIO(node_id)                                              \
+    {                                                                                 \
+        {                                                                             \
+            HD44780_DT_PIN(node_id, pin_d4), HD44780_DT_PIN(node_id, pin_d5),         \
+            HD44780_DT_PIN(node_id, pin_d6), HD44780_DT_PIN(node_id, pin_d7),         \
+            HD44780_DT_PIN(node_id, pin_rs), HD44780_DT_PIN(node_id, pin_en),         \
+        },                                                                            \
+        HD44780_DT_COLS(node_id), HD44780_DT_ROWS(node_id),                           \
+        &hd44780_gpio_transport,                                                      \
+    }
+
+#define HD44780_DT_DISPLAY_PCF8574(node_id)                                           \
+    {                                                                                 \
+        { { 0 } },                                                                    \
+        HD44780_DT_COLS(node_id), HD44780_DT_ROWS(node_id),                           \
+        &hd44780_pcf8574_transport,                                                   \
+        {                                                                             \
+            DEVICE_DT_GET(DT_BUS(node_id)), DT_REG_ADDR(node_id),                     \
+            DT_PROP(DT_BUS(node_id), clock_frequency),                                \
+        },                                                                            \
+    }
 
 enum hd44780_pins
 {
@@ -71,17 +106,147 @@ enum hd44780_cmds
     HD44780_CMD_DDRAM = 128,
 };
 
+/* characters in one DDRAM line */
+#define HD44780_DDRAM_LINE 40
+
+/* a byte for hd44780_display_entries(): the bus byte, RS (data) in bit 8 */
+#define HD44780_ENTRY_RS BIT(8)
+#define HD44780_ENTRY_DATA(c) (HD44780_ENTRY_RS | (uint8_t)(c))
+
+/* Bus timing in hw cycles, converted in hd44780_display_init() */
+struct hd44780_timing
+{
+    uint32_t en_pulse;
+    uint32_t exec;
+    uint32_t exec_long;
+    uint32_t sleep_threshold;
+    // cycle stamp at which the controller accepts the next byte
+    uint32_t ready_at;
+    bool busy;
+};
+
+/* D4-D7 on one port: the raw port value of every nibble */
+struct hd44780_bus
+{
+    const struct device *port;
+    gpio_port_pins_t mask;
+    gpio_port_value_t lut[16];
+    bool masked;
+};
+
+struct hd44780_display;
+
+/* How bytes get to the controller
+ *
+ * write() takes bytes in entry format and waits out the execution time
+ * of each before the next goes out, it leaves the display busy with the
+ * last one (see hd44780_transport.h). A transport may put any number of
+ * them in one bus transaction.
+ */
+struct hd44780_transport
+{
+    int (*setup)(struct hd44780_display *disp);
+    // one EN pulse with the high nibble of n and RS low, for the init sequence
+    void (*nibble)(struct hd44780_display *disp, uint8_t n);
+    void (*write)(struct hd44780_display *disp, const uint16_t *entries, size_t count);
+    // entries the async writer hands to write() at once
+    uint32_t batch;
+    const char *name;
+};
+
+/* D4-D7, RS and EN on GPIOs */
+extern const struct hd44780_transport hd44780_gpio_transport;
+
+#ifdef CONFIG_HD44780_PCF8574
+/* PCF8574 port bits on the common backpacks */
+#define HD44780_PCF8574_RS BIT(0)
+#define HD44780_PCF8574_RW BIT(1)
+#define HD44780_PCF8574_EN BIT(2)
+#define HD44780_PCF8574_BL BIT(3)
+#define HD44780_PCF8574_DATA_SHIFT 4
+
+/* behind a PCF8574 I2C port expander, see hd44780_pcf8574.c */
+extern const struct hd44780_transport hd44780_pcf8574_transport;
+
+struct hd44780_i2c
+{
+    const struct device *bus;
+    uint16_t addr;
+    uint32_t bitrate;
+    // filled by the transport setup
+    uint8_t port;       // last value written to the expander
+    uint8_t pad;        // filler port writes after each byte when the bus outruns the controller
+    bool failed;        // a transfer failed, reported once
+    uint8_t buf[CONFIG_HD44780_PCF8574_BURST_LEN];
+};
+#endif
+
 struct hd44780_display
 {
     struct gpio_dt_spec pin_dt[PINS_MAX];
+    uint8_t cols;
+    uint8_t rows;
+    const struct hd44780_transport *transport;
+#ifdef CONFIG_HD44780_PCF8574
+    struct hd44780_i2c i2c;
+#endif
+    // filled by hd44780_display_init()
+    struct hd44780_timing timing;
+    struct hd44780_bus bus;
 };
 
+/* Any display
+ *
+ * The byte path takes no geometry into account, DDRAM addresses are
+ * up to the caller (see hd44780.hpp for compile-time ones). A display
+ * must only be driven from one thread.
+ */
+void hd44780_display_init(struct hd44780_display *disp);
+void hd44780_display_cmd(struct hd44780_display *disp, uint8_t cmd, uint8_t flags);
+void hd44780_display_data(struct hd44780_display *disp, char val);
+void hd44780_display_wait(struct hd44780_display *disp);
+/* a DDRAM address and up to HD44780_DDRAM_LINE characters from there,
+ * a single bus transaction on the I2C backpack */
+void hd44780_display_write(struct hd44780_display *disp, uint8_t addr, const char *str, uint8_t len);
+/* bytes in entry format, see HD44780_ENTRY_RS */
+void hd44780_display_entries(struct hd44780_display *disp, const uint16_t *entries, size_t count);
 
+/* The display on HD44780_NODE
+ *
+ * Leaves the display cleared and on, with the address at 0 */
 void hd44780_init();
 void hd44780_cmd(uint8_t cmd, uint8_t flags);
 void hd44780_data(char val);
 void hd44780_pos(uint8_t row, uint8_t col);
 
+/* Async front end
+ *
+ * Bytes are queued in a single-producer ring and clocked out by a low
+ * priority writer thread, so the producer never waits on the bus.
+ * Calls return -ENOSPC (and count a drop) when the ring is full; use
+ * hd44780_async_space() to queue all-or-nothing. The blocking calls
+ * above must not be mixed in until hd44780_flush() has returned.
+ *
+ * Without CONFIG_HD44780_ASYNC these fall through to the blocking calls.
+ */
+#ifdef CONFIG_HD44780_ASYNC
+int hd44780_async_cmd(uint8_t cmd, uint8_t flags);
+int hd44780_async_data(char val);
+int hd44780_async_pos(uint8_t row, uint8_t col);
+uint32_t hd44780_async_space(void);
+uint32_t hd44780_async_high_water(void);
+uint32_t hd44780_async_dropped(void);
+void hd44780_flush(void);
+#else
+static inline int hd44780_async_cmd(uint8_t cmd, uint8_t flags) { hd44780_cmd(cmd, flags); return 0; }
+static inline int hd44780_async_data(char val) { hd44780_data(val); return 0; }
+static inline int hd44780_async_pos(uint8_t row, uint8_t col) { hd44780_pos(row, col); return 0; }
+static inline uint32_t hd44780_async_space(void) { return UINT32_MAX; }
+static inline uint32_t hd44780_async_high_water(void) { return 0; }
+static inline uint32_t hd44780_async_dropped(void) { return 0; }
+static inline void hd44780_flush(void) { }
+#endif
+
 
 #ifdef __cplusplus
 }
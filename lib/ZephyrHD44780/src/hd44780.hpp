@@ -0,0 +1,104 @@
+#ifndef HD44780_HPP
+#define HD44780_HPP
+
+#include "hd44780.h"
+
+/**
+ * @brief rows x columns of a module and where its rows start in DDRAM
+ *
+ * A 4 line module is a 2 line controller with each DDRAM line split over two
+ * rows, rows 2 and 3 start right after the visible part of rows 0 and 1.
+ *
+ * @tparam COLS columns
+ * @tparam ROWS rows, 1, 2 or 4
+ */
+template<uint8_t COLS, uint8_t ROWS>
+struct HD44780Geometry{
+    static_assert(ROWS == 1 || ROWS == 2 || ROWS == 4, "HD44780 modules have 1, 2 or 4 rows");
+    static_assert((ROWS == 4) ? (COLS <= 20) : (COLS <= 40), "a DDRAM line holds 40 characters");
+
+    static constexpr uint8_t cols = COLS;
+    static constexpr uint8_t rows = ROWS;
+
+    /**
+     * @brief DDRAM address of a cell
+     *
+     * @param row row, below ROWS
+     * @param col column, below COLS
+     * @return constexpr uint8_t the address
+     */
+    static constexpr uint8_t addr(uint8_t row, uint8_t col){
+        return ((row & 1) ? 0x40 : 0x00) + ((row & 2) ? COLS : 0) + col;
+    }
+};
+
+/* the geometry of a devicetree node, see HD44780_DT_COLS() */
+#define HD44780_DT_GEOMETRY(node_id) HD44780Geometry<HD44780_DT_COLS(node_id), HD44780_DT_ROWS(node_id)>
+
+/**
+ * @brief one HD44780 module on its own set of pins
+ *
+ * The geometry is a template parameter, so cell addresses are constants
+ * and nothing on the way to the bus looks at rows or columns. Writes are
+ * blocking, see hd44780_display_data(), and go through the transport of
+ * the node (GPIOs or a PCF8574 backpack). Define instances with
+ * HD44780_DT_DEFINE(), one per devicetree node.
+ *
+ * @tparam GEOMETRY HD44780Geometry of the module
+ */
+template<typename GEOMETRY>
+class HD44780{
+    public:
+        typedef GEOMETRY geometry;
+
+        explicit HD44780(const struct hd44780_display& pins) : disp(pins){}
+
+        /* leaves the display cleared and on, with the address at 0 */
+        void init(void) {hd44780_display_init(&this->disp);}
+        void cmd(uint8_t cmd, uint8_t flags) {hd44780_display_cmd(&this->disp, cmd, flags);}
+        void data(char val) {hd44780_display_data(&this->disp, val);}
+        void wait(void) {hd44780_display_wait(&this->disp);}
+
+        /* move the address to a cell, bounds are only asserted */
+        void pos(uint8_t row, uint8_t col){
+            __ASSERT_NO_MSG(row < GEOMETRY::rows && col < GEOMETRY::cols);
+            this->cmd(HD44780_CMD_DDRAM, GEOMETRY::addr(row, col));
+        }
+
+        template<uint8_t ROW, uint8_t COL>
+        void pos(void){
+            static_assert(ROW < GEOMETRY::rows && COL < GEOMETRY::cols, "cell outside the display");
+            this->cmd(HD44780_CMD_DDRAM, GEOMETRY::addr(ROW, COL));
+        }
+
+        /**
+         * @brief write a run of cells starting at a cell
+         *
+         * The address and the characters are one bus transaction on an I2C backpack.
+         *
+         * @param row row of the first cell
+         * @param col column of the first cell
+         * @param str characters, the run must not go past the end of the row
+         * @param len number of characters
+         */
+        void write(uint8_t row, uint8_t col, const char* str, uint8_t len){
+            __ASSERT_NO_MSG(row < GEOMETRY::rows && col + len <= GEOMETRY::cols);
+            hd44780_display_write(&this->disp, GEOMETRY::addr(row, col), str, len);
+        }
+
+    private:
+        struct hd44780_display disp;
+};
+
+/* an HD44780 instance for a devicetree node, geometry and pins or I2C address from the node */
+#define HD44780_DT_DEFINE(name, node_id) \
+    HD44780<HD44780_DT_GEOMETRY(node_id)> name(HD44780_DT_DISPLAY(node_id))
+
+
+/* compile time checks of the row addresses */
+static_assert(HD44780Geometry<16, 2>::addr(1, 0) == 0x40, "16x2 row 1");
+static_assert(HD44780Geometry<16, 4>::addr(2, 0) == 0x10 && HD44780Geometry<16, 4>::addr(3, 0) == 0x50, "16x4 rows 2/3");
+static_assert(HD44780Geometry<20, 4>::addr(2, 0) == 0x14 && HD44780Geometry<20, 4>::addr(3, 19) == 0x67, "20x4 rows 2/3");
+
+
+#endif // HD44780_HPP
@@ -0,0 +1,138 @@
+#include "hd44780.h"
+
+#ifdef CONFIG_HD44780_PCF8574
+
+#include "hd44780_transport.h"
+#include <drivers/i2c.h>
+
+/*
+ * HD44780 behind a PCF8574 backpack: every write to the expander sets all
+ * eight pins at once, D4-D7 on P4-P7 and RS, RW, EN and the backlight on
+ * P0-P3. A nibble is two port writes, one with EN high and one with EN low,
+ * and the controller latches on the falling edge. RS changes get a write of
+ * their own before the first EN rise, for the address setup time.
+ *
+ * On the wire a port write is 9 bit times, at least 9 us up to 1 MHz, which
+ * is way past the EN pulse width. Between two bytes there are two port
+ * writes, at 100 and 400 kHz more than the 37 us a byte executes, so any
+ * number of bytes go out in one i2c_write(). Faster buses get filler writes
+ * after each byte. Only CLEAR and HOME end a transaction early, the next one
+ * waits for them like the GPIO path does.
+ */
+
+// 8 data bits and the ACK
+#define I2C_BITS_PER_BYTE 9
+// port writes between the last latch of a byte and the first of the next
+#define PORT_WRITES_BETWEEN_BYTES 2
+// an RS setup write and two per nibble
+#define PORT_WRITES_MAX (1 + 4)
+
+static int
+pcf8574_put(struct hd44780_display *d, const uint8_t *buf, uint32_t len)
+{
+    struct hd44780_i2c *i2c = &d->i2c;
+    int rc = i2c_write(i2c->bus, buf, len, i2c->addr);
+
+    if (rc != 0 && !i2c->failed)
+    {
+        // the display stays blank or garbled, no point in repeating it per byte
+        printk("HD44780: PCF8574 at 0x%02x: i2c_write failed: %d\n", i2c->addr, rc);
+        i2c->failed = true;
+    }
+    return rc;
+}
+
+static uint32_t
+pcf8574_encode(struct hd44780_i2c *i2c, uint8_t *buf, uint16_t entry)
+{
+    uint8_t ctrl = HD44780_PCF8574_BL | ((entry & HD44780_ENTRY_RS) ? HD44780_PCF8574_RS : 0);
+    uint8_t hi = ctrl | (entry & 0xf0);
+    uint8_t lo = ctrl | ((entry & 0x0f) << HD44780_PCF8574_DATA_SHIFT);
+    uint32_t n = 0;
+    uint8_t pad;
+
+    if ((i2c->port ^ ctrl) & HD44780_PCF8574_RS)
+        buf[n++] = (i2c->port & ~HD44780_PCF8574_RS) | (ctrl & HD44780_PCF8574_RS);
+
+    buf[n++] = hi | HD44780_PCF8574_EN;
+    buf[n++] = hi;
+    buf[n++] = lo | HD44780_PCF8574_EN;
+    buf[n++] = lo;
+    for (pad = 0; pad < i2c->pad; pad++)
+        buf[n++] = lo;
+
+    i2c->port = lo;
+    return n;
+}
+
+static void
+pcf8574_write(struct hd44780_display *d, const uint16_t *entries, size_t count)
+{
+    struct hd44780_i2c *i2c = &d->i2c;
+    uint32_t per_entry = PORT_WRITES_MAX + i2c->pad;
+    size_t i = 0;
+
+    while (i < count)
+    {
+        uint32_t len = 0;
+        uint16_t last;
+
+        do
+        {
+            last = entries[i++];
+            len += pcf8574_encode(i2c, &i2c->buf[len], last);
+        } while (i < count && !hd44780_entry_long(last) && len + per_entry <= sizeof(i2c->buf));
+
+        hd44780_wait_ready(d);
+        pcf8574_put(d, i2c->buf, len);
+        // counted from the end of the transfer, the last byte latched just before
+        hd44780_set_busy(d, hd44780_entry_exec(d, last));
+    }
+}
+
+static void
+pcf8574_nibble(struct hd44780_display *d, uint8_t n)
+{
+    uint8_t port = HD44780_PCF8574_BL | (n & 0xf0);
+    uint8_t buf[] = {port | HD44780_PCF8574_EN, port};
+
+    hd44780_wait_ready(d);
+    pcf8574_put(d, buf, sizeof(buf));
+    d->i2c.port = port;
+}
+
+static int
+pcf8574_setup(struct hd44780_display *d)
+{
+    struct hd44780_i2c *i2c = &d->i2c;
+    uint32_t between;
+
+    if (!device_is_ready(i2c->bus))
+        return -ENODEV;
+
+    // port writes that take as long as a byte executes, the filler is what
+    // the two between bytes do not cover
+    between = DIV_ROUND_UP((uint64_t)CONFIG_HD44780_EXEC_TIME_US * i2c->bitrate,
+                           (uint64_t)I2C_BITS_PER_BYTE * USEC_PER_SEC);
+    between = (between > PORT_WRITES_BETWEEN_BYTES) ? between - PORT_WRITES_BETWEEN_BYTES : 0;
+    // a byte and its filler have to fit a burst
+    i2c->pad = MIN(between, sizeof(i2c->buf) - PORT_WRITES_MAX);
+    i2c->failed = false;
+
+    // backlight on, EN low before the first nibble
+    i2c->port = HD44780_PCF8574_BL;
+    return pcf8574_put(d, &i2c->port, 1);
+}
+
+const struct hd44780_transport hd44780_pcf8574_transport = {
+    .setup = pcf8574_setup,
+    .nibble = pcf8574_nibble,
+    .write = pcf8574_write,
+    .batch = UINT32_MAX,
+    .name = "pcf8574",
+};
+
+BUILD_ASSERT(CONFIG_HD44780_PCF8574_BURST_LEN >= PORT_WRITES_MAX,
+             "a PCF8574 burst has to hold at least one byte");
+
+#endif // CONFIG_HD44780_PCF8574
@@ -0,0 +1,112 @@
+#include "hd44780_virtual.h"
+
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+
+#define DT_DRV_COMPAT hd44780_pcf8574
+
+#include <string.h>
+#include <drivers/emul.h>
+#include <drivers/i2c.h>
+#include <drivers/i2c_emul.h>
+
+/*
+ * PCF8574 backpack on the emulated I2C controller of native_posix. Every
+ * byte written is the new state of the expander pins; on a falling edge of
+ * EN the nibble and RS that were on the pins go to the virtual HD44780 of
+ * the backpack. Transactions and bytes (address byte included) are counted
+ * for all backpacks together.
+ */
+
+struct pcf8574_emul_data
+{
+    struct i2c_emul emul;
+    const struct pcf8574_emul_cfg *cfg;
+    uint8_t port;
+};
+
+struct pcf8574_emul_cfg
+{
+    struct pcf8574_emul_data *data;
+    uint16_t addr;
+    uint8_t cols;
+    uint8_t rows;
+};
+
+static atomic_t transactions;
+static atomic_t bytes;
+
+static int
+pcf8574_emul_transfer(struct i2c_emul *emul, struct i2c_msg *msgs, int num_msgs, int addr)
+{
+    struct pcf8574_emul_data *data = CONTAINER_OF(emul, struct pcf8574_emul_data, emul);
+    const struct pcf8574_emul_cfg *cfg = data->cfg;
+    int i;
+    uint32_t j;
+
+    atomic_inc(&transactions);
+    for (i = 0; i < num_msgs; i++)
+    {
+        atomic_add(&bytes, 1 + msgs[i].len);
+
+        if (msgs[i].flags & I2C_MSG_READ)
+        {
+            // quasi-bidirectional pins read back what was written
+            memset(msgs[i].buf, data->port, msgs[i].len);
+            continue;
+        }
+
+        for (j = 0; j < msgs[i].len; j++)
+        {
+            uint8_t port = msgs[i].buf[j];
+
+            if ((data->port & HD44780_PCF8574_EN) && !(port & HD44780_PCF8574_EN))
+            {
+                hd44780_virtual_latch(data, cfg->cols, cfg->rows,
+                                      data->port & HD44780_PCF8574_RS,
+                                      data->port >> HD44780_PCF8574_DATA_SHIFT);
+            }
+            data->port = port;
+        }
+    }
+    return 0;
+}
+
+static const struct i2c_emul_api pcf8574_emul_api = {
+    .transfer = pcf8574_emul_transfer,
+};
+
+static int
+pcf8574_emul_init(const struct emul *target, const struct device *parent)
+{
+    const struct pcf8574_emul_cfg *cfg = target->cfg;
+    struct pcf8574_emul_data *data = cfg->data;
+
+    data->emul.api = &pcf8574_emul_api;
+    data->emul.addr = cfg->addr;
+    data->cfg = cfg;
+    // pins come up high after power-on
+    data->port = 0xff;
+
+    return i2c_emul_register(parent, target->dev_label, &data->emul);
+}
+
+void
+hd44780_virtual_i2c_stats(struct hd44780_virtual_i2c *out)
+{
+    out->transactions = atomic_get(&transactions);
+    out->bytes = atomic_get(&bytes);
+}
+
+#define PCF8574_EMUL(n)                                                       \
+    static struct pcf8574_emul_data pcf8574_emul_data_##n;                   \
+    static const struct pcf8574_emul_cfg pcf8574_emul_cfg_##n = {            \
+        .data = &pcf8574_emul_data_##n,                                      \
+        .addr = DT_INST_REG_ADDR(n),                                         \
+        .cols = HD44780_DT_COLS(DT_DRV_INST(n)),                             \
+        .rows = HD44780_DT_ROWS(DT_DRV_INST(n)),                             \
+    };                                                                        \
+    EMUL_DEFINE(pcf8574_emul_init, DT_DRV_INST(n), &pcf8574_emul_cfg_##n)
+
+DT_INST_FOREACH_STATUS_OKAY(PCF8574_EMUL)
+
+#endif // CONFIG_HD44780_PCF8574_EMUL
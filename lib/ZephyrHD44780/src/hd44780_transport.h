@@ -0,0 +1,78 @@
+#ifndef HD44780_TRANSPORT_H
+#define HD44780_TRANSPORT_H
+
+/* Timing helpers shared by the transports, not part of the driver API */
+
+#include "hd44780.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void
+hd44780_spin(uint32_t cycles)
+{
+#ifdef CONFIG_ARCH_POSIX
+    // simulated time only moves when the cpu idles or busy-waits
+    k_busy_wait(k_cyc_to_us_ceil32(cycles));
+#else
+    uint32_t start = k_cycle_get_32();
+
+    while ((k_cycle_get_32() - start) < cycles)
+    {
+    }
+#endif
+}
+
+/*
+ * Wait out the execution time of the previous byte. Nothing is waited for
+ * right after a write, so whatever the caller does between two bytes
+ * (formatting, diffing) overlaps with the controller executing.
+ */
+static inline void
+hd44780_wait_ready(struct hd44780_display *d)
+{
+    struct hd44780_timing *timing = &d->timing;
+
+    if (!timing->busy)
+        return;
+
+    int32_t remaining = (int32_t)(timing->ready_at - k_cycle_get_32());
+
+    if (remaining > (int32_t)timing->sleep_threshold)
+    {
+        // long enough to be worth giving the cpu away (CLEAR/HOME)
+        k_usleep(k_cyc_to_us_floor32(remaining));
+        remaining = (int32_t)(timing->ready_at - k_cycle_get_32());
+    }
+    if (remaining > 0)
+        hd44780_spin(remaining);
+
+    timing->busy = false;
+}
+
+static inline void
+hd44780_set_busy(struct hd44780_display *d, uint32_t exec_cycles)
+{
+    d->timing.ready_at = k_cycle_get_32() + exec_cycles;
+    d->timing.busy = true;
+}
+
+/* only CLEAR (0x01) and HOME (0x02/0x03) take 1.52 ms, everything else 37 us */
+static inline bool
+hd44780_entry_long(uint16_t entry)
+{
+    return !(entry & HD44780_ENTRY_RS) && (uint8_t)entry < HD44780_CMD_MODE;
+}
+
+static inline uint32_t
+hd44780_entry_exec(const struct hd44780_display *d, uint16_t entry)
+{
+    return hd44780_entry_long(entry) ? d->timing.exec_long : d->timing.exec;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HD44780_TRANSPORT_H
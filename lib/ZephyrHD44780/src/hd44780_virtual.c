@@ -0,0 +1,395 @@
+#include "hd44780_virtual.h"
+
+#ifdef CONFIG_HD44780_VIRTUAL
+
+#include <string.h>
+#include <drivers/gpio/gpio_emul.h>
+
+/* Datasheet minimums at fosc = 270 kHz */
+#define PW_EH_NS 450
+#define T_CYCE_NS 1000
+#define EXEC_NS 37000
+#define EXEC_LONG_NS 1520000
+
+#define DDRAM_ROW_OFFSET 0x40
+#define DDRAM_ROW_LEN 40
+
+struct virtual_lcd
+{
+    char ddram[DDRAM_ROW_OFFSET * 2];
+    uint8_t addr;
+    bool increment;
+    bool display_on;
+    bool four_bit;
+    // first nibble of a byte has been latched in 4 bit mode
+    bool have_high;
+    uint8_t high;
+};
+
+struct virtual_bus
+{
+    uint32_t en_rise;
+    uint32_t last_rise;
+    bool seen_rise;
+    uint32_t byte_start;
+    // cycle stamp at which the last byte finished executing
+    uint32_t ready_at;
+    bool have_byte;
+    struct hd44780_virtual_stats stats;
+};
+
+/* one model per display, in the order they first latch a nibble */
+static struct virtual_model
+{
+    // the struct hd44780_display, or the bus emulator feeding the model
+    const void *owner;
+    uint8_t cols;
+    uint8_t rows;
+    // fed from the GPIOs, so bus timing can be checked
+    bool timed;
+    struct virtual_lcd lcd;
+    struct virtual_bus bus;
+} models[HD44780_VIRTUAL_MAX_DISPLAYS];
+
+static struct k_spinlock models_lock;
+
+static void
+reset_stats(struct virtual_bus *bus)
+{
+    memset(&bus->stats, 0, sizeof(bus->stats));
+    bus->stats.min_en_high_ns = UINT32_MAX;
+    bus->stats.min_en_cycle_ns = UINT32_MAX;
+    bus->stats.min_byte_gap_ns = UINT32_MAX;
+}
+
+static struct virtual_model *
+model_of(const void *owner, uint8_t cols, uint8_t rows, bool timed)
+{
+    struct virtual_model *model = NULL;
+    uint8_t i;
+
+    for (i = 0; i < HD44780_VIRTUAL_MAX_DISPLAYS; i++)
+    {
+        if (models[i].owner == owner)
+            return &models[i];
+    }
+
+    // first nibble of a display, displays may be set up from different threads
+    k_spinlock_key_t key = k_spin_lock(&models_lock);
+    for (i = 0; i < HD44780_VIRTUAL_MAX_DISPLAYS; i++)
+    {
+        if (models[i].owner == NULL)
+        {
+            model = &models[i];
+            // power-on contents are undefined, blanks make dumps readable
+            memset(model->lcd.ddram, ' ', sizeof(model->lcd.ddram));
+            model->lcd.increment = true;
+            reset_stats(&model->bus);
+            model->cols = cols;
+            model->rows = rows;
+            model->timed = timed;
+            model->owner = owner;
+            break;
+        }
+    }
+    k_spin_unlock(&models_lock, key);
+
+    return model;
+}
+
+static int
+pin(const struct hd44780_display *disp, enum hd44780_pins p)
+{
+    // the controller sees the wire, so ignore GPIO_ACTIVE_LOW
+    return gpio_emul_output_get(disp->pin_dt[p].port, disp->pin_dt[p].pin) > 0;
+}
+
+static void
+addr_step(struct virtual_lcd *lcd)
+{
+    if (lcd->increment)
+    {
+        if (lcd->addr == DDRAM_ROW_LEN - 1)
+            lcd->addr = DDRAM_ROW_OFFSET;
+        else if (lcd->addr == DDRAM_ROW_OFFSET + DDRAM_ROW_LEN - 1)
+            lcd->addr = 0;
+        else
+            lcd->addr++;
+    }
+    else
+    {
+        if (lcd->addr == 0)
+            lcd->addr = DDRAM_ROW_OFFSET + DDRAM_ROW_LEN - 1;
+        else if (lcd->addr == DDRAM_ROW_OFFSET)
+            lcd->addr = DDRAM_ROW_LEN - 1;
+        else
+            lcd->addr--;
+    }
+}
+
+static uint32_t
+execute_cmd(struct virtual_lcd *lcd, uint8_t cmd)
+{
+    if (cmd & HD44780_CMD_DDRAM)
+    {
+        lcd->addr = cmd & 0x7f;
+    }
+    else if (cmd & HD44780_CMD_CGRAM)
+    {
+        // custom glyphs are not modelled
+    }
+    else if (cmd & HD44780_CMD_CONFIG)
+    {
+        lcd->four_bit = !(cmd & HD44780_CONFIG_DATA8);
+        lcd->have_high = false;
+    }
+    else if (cmd & HD44780_CMD_SHIFT)
+    {
+        // only cursor moves are modelled, display shift is ignored
+        if (!(cmd & HD44780_SHIFT_DISP))
+        {
+            bool increment = lcd->increment;
+            lcd->increment = cmd & HD44780_SHIFT_RIGHT;
+            addr_step(lcd);
+            lcd->increment = increment;
+        }
+    }
+    else if (cmd & HD44780_CMD_ONOFF)
+    {
+        lcd->display_on = cmd & HD44780_ONOFF_DISP_ON;
+    }
+    else if (cmd & HD44780_CMD_MODE)
+    {
+        lcd->increment = cmd & HD44780_MODE_INC;
+    }
+    else if (cmd & HD44780_CMD_HOME)
+    {
+        lcd->addr = 0;
+        return EXEC_LONG_NS;
+    }
+    else if (cmd & HD44780_CMD_CLEAR)
+    {
+        memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+        lcd->addr = 0;
+        lcd->increment = true;
+        return EXEC_LONG_NS;
+    }
+
+    return EXEC_NS;
+}
+
+static void
+execute(struct virtual_model *model, bool rs, uint8_t b, uint32_t start, uint32_t now)
+{
+    uint32_t exec_ns;
+
+    if (model->timed && model->bus.have_byte)
+    {
+        int32_t gap = (int32_t)(start - model->bus.ready_at);
+
+        if (gap < 0)
+        {
+            model->bus.stats.exec_violations++;
+            gap = 0;
+        }
+        uint32_t gap_ns = k_cyc_to_ns_floor32(gap);
+        if (gap_ns < model->bus.stats.min_byte_gap_ns)
+            model->bus.stats.min_byte_gap_ns = gap_ns;
+    }
+
+    if (rs)
+    {
+        model->lcd.ddram[model->lcd.addr] = (char)b;
+        addr_step(&model->lcd);
+        model->bus.stats.data++;
+        exec_ns = EXEC_NS;
+    }
+    else
+    {
+        exec_ns = execute_cmd(&model->lcd, b);
+        model->bus.stats.cmds++;
+    }
+
+    model->bus.ready_at = now + k_ns_to_cyc_ceil32(exec_ns);
+    model->bus.have_byte = true;
+}
+
+static void
+latch(struct virtual_model *model, bool rs, uint8_t nibble, uint32_t start, uint32_t now)
+{
+    struct virtual_lcd *lcd = &model->lcd;
+
+    if (!lcd->four_bit)
+    {
+        // D0-D3 are not wired, they read as 0
+        execute(model, rs, nibble << 4, start, now);
+    }
+    else if (!lcd->have_high)
+    {
+        lcd->high = nibble;
+        lcd->have_high = true;
+        model->bus.byte_start = start;
+    }
+    else
+    {
+        lcd->have_high = false;
+        execute(model, rs, lcd->high << 4 | nibble, model->bus.byte_start, now);
+    }
+}
+
+void
+hd44780_virtual_en(const struct hd44780_display *disp, int level)
+{
+    struct virtual_model *model = model_of(disp, disp->cols, disp->rows, true);
+    uint32_t now = k_cycle_get_32();
+
+    if (model == NULL)
+        return;
+
+    struct virtual_bus *bus = &model->bus;
+
+    if (level)
+    {
+        if (bus->seen_rise)
+        {
+            uint32_t cycle_ns = k_cyc_to_ns_floor32(now - bus->last_rise);
+            if (cycle_ns < T_CYCE_NS)
+                bus->stats.pulse_violations++;
+            if (cycle_ns < bus->stats.min_en_cycle_ns)
+                bus->stats.min_en_cycle_ns = cycle_ns;
+        }
+        bus->en_rise = now;
+        bus->last_rise = now;
+        bus->seen_rise = true;
+        return;
+    }
+
+    uint32_t high_ns = k_cyc_to_ns_floor32(now - bus->en_rise);
+    if (high_ns < PW_EH_NS)
+        bus->stats.pulse_violations++;
+    if (high_ns < bus->stats.min_en_high_ns)
+        bus->stats.min_en_high_ns = high_ns;
+
+    bool rs = pin(disp, RS);
+    uint8_t nibble = pin(disp, D4) | pin(disp, D5) << 1 |
+                     pin(disp, D6) << 2 | pin(disp, D7) << 3;
+
+    latch(model, rs, nibble, bus->en_rise, now);
+}
+
+void
+hd44780_virtual_latch(const void *owner, uint8_t cols, uint8_t rows, bool rs, uint8_t nibble)
+{
+    struct virtual_model *model = model_of(owner, cols, rows, false);
+    uint32_t now = k_cycle_get_32();
+
+    if (model == NULL)
+        return;
+
+    latch(model, rs, nibble, now, now);
+}
+
+void
+hd44780_virtual_display_row(uint8_t display, uint8_t row, char *buf)
+{
+    const struct virtual_model *model;
+
+    buf[0] = '\0';
+    if (display >= HD44780_VIRTUAL_MAX_DISPLAYS || models[display].owner == NULL)
+        return;
+
+    model = &models[display];
+    if (row >= model->rows)
+        return;
+
+    // rows 2 and 3 of a 4 line module continue the DDRAM lines of rows 0 and 1
+    memcpy(buf, &model->lcd.ddram[(row & 1) * DDRAM_ROW_OFFSET + ((row & 2) ? model->cols : 0)],
+           model->cols);
+    buf[model->cols] = '\0';
+}
+
+void
+hd44780_virtual_row(uint8_t row, char *buf)
+{
+    hd44780_virtual_display_row(0, row, buf);
+}
+
+void
+hd44780_virtual_stats(struct hd44780_virtual_stats *out)
+{
+    *out = models[0].bus.stats;
+}
+
+void
+hd44780_virtual_reset_stats(void)
+{
+    for (uint8_t i = 0; i < HD44780_VIRTUAL_MAX_DISPLAYS; i++)
+        reset_stats(&models[i].bus);
+}
+
+void
+hd44780_virtual_dump(void)
+{
+    char row[HD44780_VIRTUAL_COLS + 1];
+    uint8_t i, r;
+
+    for (i = 0; i < HD44780_VIRTUAL_MAX_DISPLAYS; i++)
+    {
+        const struct virtual_model *model = &models[i];
+
+        if (model->owner == NULL)
+            continue;
+
+        for (r = 0; r < model->rows; r++)
+        {
+            hd44780_virtual_display_row(i, r, row);
+            printk("LCD%u.%u |%s|%s\n", i, r, row, model->lcd.display_on ? "" : " (off)");
+        }
+        if (!model->timed)
+        {
+            printk("LCD%u bus: %u cmds %u data (bus emulator, timing not checked)\n", i,
+                   model->bus.stats.cmds, model->bus.stats.data);
+            continue;
+        }
+        printk("LCD%u bus: %u cmds %u data, violations pulse %u exec %u, "
+               "min EN high %u ns cycle %u ns byte gap %u ns\n", i,
+               model->bus.stats.cmds, model->bus.stats.data,
+               model->bus.stats.pulse_violations, model->bus.stats.exec_violations,
+               model->bus.stats.min_en_high_ns, model->bus.stats.min_en_cycle_ns,
+               model->bus.stats.min_byte_gap_ns);
+    }
+
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+    struct hd44780_virtual_i2c i2c;
+
+    hd44780_virtual_i2c_stats(&i2c);
+    printk("LCD I2C: %u transactions %u bytes on the wire\n", i2c.transactions, i2c.bytes);
+#endif
+}
+
+#if CONFIG_HD44780_VIRTUAL_DUMP_INTERVAL_MS > 0
+static void dump_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(dump_work, dump_work_handler);
+
+static void
+dump_work_handler(struct k_work *work)
+{
+    hd44780_virtual_dump();
+    k_work_schedule(&dump_work, K_MSEC(CONFIG_HD44780_VIRTUAL_DUMP_INTERVAL_MS));
+}
+#endif
+
+static int
+hd44780_virtual_setup(const struct device *unused)
+{
+    ARG_UNUSED(unused);
+
+#if CONFIG_HD44780_VIRTUAL_DUMP_INTERVAL_MS > 0
+    k_work_schedule(&dump_work, K_MSEC(CONFIG_HD44780_VIRTUAL_DUMP_INTERVAL_MS));
+#endif
+    return 0;
+}
+
+SYS_INIT(hd44780_virtual_setup, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif // CONFIG_HD44780_VIRTUAL
@@ -0,0 +1,76 @@
+#ifndef HD44780_VIRTUAL_H
+#define HD44780_VIRTUAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "hd44780.h"
+
+/* Virtual HD44780 for host builds
+ *
+ * The driver reports every EN edge; on the falling edge the model samples
+ * RS and D4-D7 from the emulated GPIO controller, decodes the nibble stream
+ * like the controller would (8 bit mode until a function set selects 4 bit)
+ * and keeps DDRAM for a 2 line controller. Bus timing is checked against the
+ * datasheet minimums, violations are counted rather than asserted.
+ *
+ * Every display gets its own model when it first latches a nibble, display
+ * 0 is the one set up first (the hd44780_*() display). Rows are cut out of
+ * DDRAM with the geometry of the struct hd44780_display.
+ *
+ * Displays on I2C backpacks are fed by the PCF8574 emulator on Zephyr's
+ * emulated I2C bus (CONFIG_HD44780_PCF8574_EMUL), which hands over whole
+ * nibbles through hd44780_virtual_latch(). Their bus timing is up to the
+ * I2C clock and not checked, the emulator counts the traffic instead.
+ */
+
+// widest row of a 4 line module
+#define HD44780_VIRTUAL_COLS 20
+#define HD44780_VIRTUAL_MAX_DISPLAYS 2
+
+struct hd44780_virtual_stats
+{
+    uint32_t cmds;
+    uint32_t data;
+    // EN high shorter than PW_EH, or EN rising edges closer than t_cycE
+    uint32_t pulse_violations;
+    // a byte started before the previous one finished executing
+    uint32_t exec_violations;
+    uint32_t min_en_high_ns;
+    uint32_t min_en_cycle_ns;
+    // smallest gap between the end of a byte and the start of the next
+    uint32_t min_byte_gap_ns;
+};
+
+void hd44780_virtual_en(const struct hd44780_display *disp, int level);
+/* a nibble latched by a bus emulator, @owner identifies the display */
+void hd44780_virtual_latch(const void *owner, uint8_t cols, uint8_t rows, bool rs, uint8_t nibble);
+
+/* Copies the visible characters of @row into @buf, NUL terminated.
+ * @buf must hold HD44780_VIRTUAL_COLS + 1 bytes. */
+void hd44780_virtual_display_row(uint8_t display, uint8_t row, char *buf);
+/* the same for display 0 */
+void hd44780_virtual_row(uint8_t row, char *buf);
+/* of display 0 */
+void hd44780_virtual_stats(struct hd44780_virtual_stats *out);
+void hd44780_virtual_reset_stats(void);
+void hd44780_virtual_dump(void);
+
+#ifdef CONFIG_HD44780_PCF8574_EMUL
+/* what the PCF8574 emulator saw, all backpacks together */
+struct hd44780_virtual_i2c
+{
+    uint32_t transactions;
+    // address bytes included
+    uint32_t bytes;
+};
+
+void hd44780_virtual_i2c_stats(struct hd44780_virtual_i2c *out);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HD44780_VIRTUAL_H
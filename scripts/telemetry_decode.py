@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Decode the stopwatch telemetry stream (see lib/Telemetry/src/telemetry.hpp).
+
+    telemetry_decode.py /dev/pts/N            # native_posix, UART_1
+    telemetry_decode.py /dev/ttyACM0 -b 115200
+    telemetry_decode.py capture.bin -q        # a recorded stream
+
+Prints every record, and once a second (and at the end) the throughput and
+the records lost to CRC errors and sequence gaps. A gap is a record the
+firmware dropped because its buffer was full.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import termios
+import time
+import tty
+
+SYNC = b"\xa5\x5a"
+RECORD_LEN = 26
+BODY = struct.Struct("<BBIQQ")  # type, state, seq, timestamp_us, value_us
+
+TYPES = {1: "STATE", 2: "LAP", 3: "TEST"}
+STATES = {0: "IDLE", 1: "RUN", 2: "PAUSE", 3: "RESET"}
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """Zephyr's crc16_ccitt(): reflected 0x1021, no final xor."""
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def fmt_us(us):
+    return "%02u:%02u.%06u" % (us // 60000000, us // 1000000 % 60, us % 1000000)
+
+
+class Decoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.records = 0
+        self.crc_errors = 0
+        self.gaps = 0
+        self.bytes = 0
+        self.next_seq = None
+
+    def feed(self, data):
+        self.bytes += len(data)
+        self.buf += data
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                del self.buf[:-1]
+                return
+            if len(self.buf) - start < RECORD_LEN:
+                del self.buf[:start]
+                return
+            record = bytes(self.buf[start:start + RECORD_LEN])
+            crc = struct.unpack_from("<H", record, 24)[0]
+            if crc16_ccitt(record[2:24]) != crc:
+                # not a record boundary after all, resync one byte further
+                self.crc_errors += 1
+                del self.buf[:start + 1]
+                continue
+            del self.buf[:start + RECORD_LEN]
+            fields = BODY.unpack_from(record, 2)
+            self.account(fields[2])
+            self.records += 1
+            self.on_record(*fields)
+
+    def account(self, seq):
+        if self.next_seq is not None and seq != self.next_seq:
+            self.gaps += (seq - self.next_seq) & 0xFFFFFFFF
+        self.next_seq = (seq + 1) & 0xFFFFFFFF
+
+    def on_record(self, kind, state, seq, timestamp_us, value_us):
+        pass
+
+
+class Printer(Decoder):
+    def __init__(self, quiet):
+        super().__init__()
+        self.quiet = quiet
+
+    def on_record(self, kind, state, seq, timestamp_us, value_us):
+        if self.quiet:
+            return
+        print("%10u %s %-5s %-5s %s" % (seq, fmt_us(timestamp_us), TYPES.get(kind, kind),
+                                        STATES.get(state, state), fmt_us(value_us)))
+
+
+def open_stream(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        if baud:
+            attrs = termios.tcgetattr(fd)
+            speed = getattr(termios, "B%d" % baud)
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def report(dec, elapsed, window_bytes, window_records, window):
+    print("# %.1f s: %d records %d B total, %.0f rec/s %.0f B/s, crc errors %d, dropped %d"
+          % (elapsed, dec.records, dec.bytes, window_records / window, window_bytes / window,
+             dec.crc_errors, dec.gaps), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("path", help="tty, pseudo-tty or capture file")
+    parser.add_argument("-b", "--baud", type=int, help="set the tty to this baud rate")
+    parser.add_argument("-q", "--quiet", action="store_true", help="only print the throughput")
+    parser.add_argument("-t", "--time", type=float, help="stop after this many seconds")
+    args = parser.parse_args()
+
+    fd = open_stream(args.path, args.baud)
+    dec = Printer(args.quiet)
+    start = last = time.monotonic()
+    last_bytes = last_records = 0
+
+    try:
+        while True:
+            data = os.read(fd, 4096)
+            if not data and not os.isatty(fd):
+                break
+            dec.feed(data)
+            now = time.monotonic()
+            if now - last >= 1.0:
+                report(dec, now - start, dec.bytes - last_bytes, dec.records - last_records, now - last)
+                last, last_bytes, last_records = now, dec.bytes, dec.records
+            if args.time is not None and now - start >= args.time:
+                break
+    except KeyboardInterrupt:
+        pass
+
+    elapsed = max(time.monotonic() - start, 1e-6)
+    report(dec, elapsed, dec.bytes, dec.records, elapsed)
+
+
+if __name__ == "__main__":
+    main()
@@ -3,83 +3,191 @@
 #include <drivers/gpio.h>
 #include <lcd.hpp>
 #include <stopwatchperipherals.hpp>
+#include <gesture.hpp>
+#include <gesturechannel.hpp>
+#include <laplog.hpp>
+#include <keypad.hpp>
+#include <remote.hpp>
+#include <telemetry.hpp>
+#include <benchmark.hpp>
+#include <cstring>
+#ifdef CONFIG_STOPWATCH_STACK_REPORT
+#include <debug/thread_analyzer.h>
+#endif
 
 StopWatchPeripherals peripherals;
-
-/* Message queue for the sw0 pressed state for pressed button
-*  true     = button is pressed down
-*  false    = button is released
-*/
-K_MSGQ_DEFINE(sw0_pressed_bool_lcd, sizeof(bool), 2, 0);
-K_MSGQ_DEFINE(sw0_pressed_bool_led, sizeof(bool), 2, 0);
-
+GestureClassifier gestures;
+
+/* The debounced sw0 gestures are published once, each thread reads them through its own subscriber */
+GestureChannel sw0_gestures;
+struct gesture_subscriber sw0_gestures_lcd;
+struct gesture_subscriber sw0_gestures_led;
+
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+/*The display and the LEDs run as work items on one queue*/
+K_THREAD_STACK_DEFINE(stopwatch_wq_stack, CONFIG_STOPWATCH_WORKQUEUE_STACK_SIZE);
+struct k_work_q stopwatch_wq;
+#else
 /*Defines for initializing threads*/
-K_THREAD_STACK_DEFINE(t0_stack_area, 2048);
-K_THREAD_STACK_DEFINE(t1_stack_area, 2048);
+K_THREAD_STACK_DEFINE(t0_stack_area, CONFIG_STOPWATCH_LCD_STACK_SIZE);
+K_THREAD_STACK_DEFINE(t1_stack_area, CONFIG_STOPWATCH_LED_STACK_SIZE);
 
 struct k_thread t0_data;
 struct k_thread t1_data;
+#endif
 
-
-/*Helper variables for the callback*/
-bool pressed = false;
-uint32_t pressed_time;
+/*what the two threads used before the stack sizes became configurable, the baseline for the RAM report*/
+const size_t LEGACY_THREAD_STACK_SIZE = 2048;
 
 
 /**
  * @brief callback for the buttonpress
  * 
- * When pressed down: Get uptime and put it in the two queues. 
- * Also put new state to the pressed_bool queues
+ * Called on both edges of sw0. Debouncing and deciding what kind of press it 
+ * was is left to the GestureClassifier, which puts the result in the queues.
  * 
  * @param port  part of the callback function syntax
  * @param cb    part of the callback function syntax    
  * @param pin   part of the callback function syntax
  */
 void handle_button_pressed_down(const struct device* port, struct gpio_callback* cb, gpio_port_pins_t pin){
-    
-    if(pressed){
-        pressed = false;
-        k_msgq_put(&sw0_pressed_bool_lcd, &pressed, K_NO_WAIT);
-        k_msgq_put(&sw0_pressed_bool_led, &pressed, K_NO_WAIT);
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    uint32_t start = k_cycle_get_32();
+    gestures.on_edge();
+    bench_stat_add(&bench_isr, k_cycle_get_32() - start);
+#else
+    gestures.on_edge();
+#endif
+}
+
+
+#ifdef CONFIG_STOPWATCH_CPU_LOAD_REPORT
+/**
+ * @brief k_thread_foreach callback, picks out the idle thread
+ * 
+ * @param thread current thread
+ * @param user_data k_thread** receiving the idle thread
+ */
+static void find_idle_thread(const struct k_thread* thread, void* user_data){
+    if(strcmp(k_thread_name_get((k_tid_t)thread), "idle") == 0){
+        *(const struct k_thread**)user_data = thread;
+    }
+}
+
+/**
+ * @brief print how much of the last interval was spent in the idle thread
+ * 
+ */
+static void report_cpu_load(void){
+    static const struct k_thread* idle_thread = NULL;
+    static uint64_t last_idle_cycles = 0;
+    static int64_t last_ticks = 0;
+    k_thread_runtime_stats_t idle_stats;
+
+    if(idle_thread == NULL){
+        k_thread_foreach(find_idle_thread, &idle_thread);
+        if(idle_thread == NULL){
+            return;
+        }
     }
-    else{
-        
-        pressed = true;
-        k_msgq_put(&sw0_pressed_bool_lcd, &pressed, K_NO_WAIT);
-        k_msgq_put(&sw0_pressed_bool_led, &pressed, K_NO_WAIT);
 
+    k_thread_runtime_stats_get((k_tid_t)idle_thread, &idle_stats);
+    // the 32-bit cycle counter wraps after 53 s at 80 MHz, the interval is taken from the uptime
+    int64_t now = k_uptime_ticks();
+    uint64_t elapsed = k_ticks_to_cyc_floor64(now - last_ticks);
+    uint64_t idle = idle_stats.execution_cycles - last_idle_cycles;
+
+    if(last_ticks != 0 && elapsed > 0){
+        uint32_t idle_permille = (uint32_t)MIN((idle * 1000) / elapsed, 1000);
+        printk("CPU load: %u.%u%% (idle %u.%u%%)\n",
+               (1000 - idle_permille) / 10, (1000 - idle_permille) % 10,
+               idle_permille / 10, idle_permille % 10);
     }
 
-    
+    last_idle_cycles = idle_stats.execution_cycles;
+    last_ticks = now;
+}
+#endif
+
 
+#ifdef CONFIG_STOPWATCH_STACK_REPORT
+/**
+ * @brief print the stack high-water marks of all threads and the RAM the stopwatch threads take
+ * 
+ * The thread analyzer output is what the stack size options should be tuned from.
+ */
+static void report_stacks(void){
+    size_t legacy = 2 * (LEGACY_THREAD_STACK_SIZE + sizeof(struct k_thread));
+
+    thread_analyzer_print();
+
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+    size_t used = K_THREAD_STACK_SIZEOF(stopwatch_wq_stack) + sizeof(struct k_work_q);
+#else
+    size_t used = K_THREAD_STACK_SIZEOF(t0_stack_area) + K_THREAD_STACK_SIZEOF(t1_stack_area) + 
+                  2 * sizeof(struct k_thread);
+#endif
+    printk("Stopwatch stacks: %u bytes, %d bytes saved against two %u byte threads\n",
+           (uint32_t)used, (int)legacy - (int)used, (uint32_t)LEGACY_THREAD_STACK_SIZE);
 }
+#endif
 
 
 void main(void)
 {
+    // the display goes first. its init mostly waits for the controller, and the
+    // power-on wait counts from boot, so the setup below overlaps with it
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+    const struct k_work_queue_config wq_config = {.name = "stopwatch_wq", .no_yield = false};
+
+    k_work_queue_start(&stopwatch_wq, stopwatch_wq_stack, K_THREAD_STACK_SIZEOF(stopwatch_wq_stack),
+                       CONFIG_STOPWATCH_WORKQUEUE_PRIORITY, &wq_config);
+    lcd_start(&stopwatch_wq, &sw0_gestures, &sw0_gestures_lcd);
+#else
+    sw0_gestures.subscribe(&sw0_gestures_lcd);
+    sw0_gestures.subscribe(&sw0_gestures_led);
 
-    
-    peripherals.init(handle_button_pressed_down); //Init peripherals by passing the callback function
-    
-    
-    
     k_tid_t t0_tid = k_thread_create(   &t0_data, t0_stack_area,
                                         K_THREAD_STACK_SIZEOF(t0_stack_area),
                                         lcd_run,
-                                        (void*)&sw0_pressed_bool_lcd, NULL, NULL,   
-                                        2, 0, K_MSEC(1000));
-    
+                                        (void*)&sw0_gestures, (void*)&sw0_gestures_lcd, NULL,
+                                        2, 0, K_NO_WAIT);
+    k_thread_name_set(t0_tid, "lcd");
+#endif
+
+    laplog_init();  //the display waits for this before it restores the saved session
+    telemetry_init();   //before the first gesture, -ENOTSUP without a telemetry UART
+    gestures.init(&peripherals.spec_pin_sw0, &sw0_gestures);
+    peripherals.init(handle_button_pressed_down); //Init peripherals by passing the callback function
+    keypad_init(&sw0_gestures);     //the keypad publishes next to sw0, -ENOTSUP without it
+    remote_init(&sw0_gestures);     //so do remote commands, -ENOTSUP without a remote UART
+
+    // the LEDs only depend on the peripherals
+#ifdef CONFIG_STOPWATCH_WORKQUEUE
+    leds_start(&stopwatch_wq, &peripherals, &sw0_gestures, &sw0_gestures_led);
+#else
    k_tid_t t1_tid = k_thread_create(   &t1_data, t1_stack_area,
                                         K_THREAD_STACK_SIZEOF(t1_stack_area),
                                         run_leds,
-                                        (void*)&peripherals, (void*)&sw0_pressed_bool_led, NULL,
-                                        2, 0, K_MSEC(1000));
+                                        (void*)&peripherals, (void*)&sw0_gestures, (void*)&sw0_gestures_led,
+                                        2, 0, K_NO_WAIT);
+    k_thread_name_set(t1_tid, "leds");
+#endif
                        
+#ifdef CONFIG_STOPWATCH_BENCHMARK
+    bench_run(&peripherals.spec_pin_sw0);
+#endif
 
+#ifdef CONFIG_STOPWATCH_STACK_REPORT
+    k_msleep(CONFIG_STOPWATCH_STACK_REPORT_DELAY_S * 1000);
+    report_stacks();
+#endif
 
+#ifdef CONFIG_STOPWATCH_CPU_LOAD_REPORT
     while(true){
-        k_msleep(1000);
+        k_msleep(CONFIG_STOPWATCH_CPU_LOAD_REPORT_INTERVAL_S * 1000);
+        report_cpu_load();
     }
-
+#endif
+    //nothing left to do, the threads (or the workqueue) carry on without main
 }
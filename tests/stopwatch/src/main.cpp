@@ -0,0 +1,50 @@
+/**
+ * @file main.cpp
+ * @brief Unit tests of the stopwatch libraries, run with twister on native_posix
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include <ztest.h>
+
+void test_fsm_button_session(void);
+void test_fsm_keys(void);
+void test_fsm_bounds_and_restore(void);
+void test_laphistory_stats(void);
+void test_laphistory_long_laps(void);
+void test_laphistory_ring_wrap(void);
+void test_channel_in_order(void);
+void test_channel_drops(void);
+void test_channel_late_subscriber(void);
+void test_channel_subscriber_limit(void);
+void test_channel_work(void);
+void test_timecounter_advance(void);
+void test_timecounter_past_ms_wrap(void);
+void test_laplog_replay(void);
+void test_laplog_partial_batch_takeover(void);
+void test_laplog_ring_wrap(void);
+void test_laplog_clear(void);
+
+void test_main(void){
+    ztest_test_suite(stopwatch,
+                     ztest_unit_test(test_fsm_button_session),
+                     ztest_unit_test(test_fsm_keys),
+                     ztest_unit_test(test_fsm_bounds_and_restore),
+                     ztest_unit_test(test_laphistory_stats),
+                     ztest_unit_test(test_laphistory_long_laps),
+                     ztest_unit_test(test_laphistory_ring_wrap),
+                     ztest_unit_test(test_channel_in_order),
+                     ztest_unit_test(test_channel_drops),
+                     ztest_unit_test(test_channel_late_subscriber),
+                     ztest_unit_test(test_channel_subscriber_limit),
+                     ztest_unit_test(test_channel_work),
+                     ztest_unit_test(test_timecounter_advance),
+                     ztest_unit_test(test_timecounter_past_ms_wrap),
+                     // the lap log tests build on each other, keep them in this order
+                     ztest_unit_test(test_laplog_replay),
+                     ztest_unit_test(test_laplog_partial_batch_takeover),
+                     ztest_unit_test(test_laplog_ring_wrap),
+                     ztest_unit_test(test_laplog_clear));
+    ztest_run_test_suite(stopwatch);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file test_fsm.cpp
+ * @brief SW_TRANSITIONS walked through the way the button and the keypad use it
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include <ztest.h>
+#include <stopwatchfsm.hpp>
+
+
+/**
+ * @brief one session on the button: start, lap, pause, resume, reset, start again
+ * 
+ */
+void test_fsm_button_session(void){
+    StopwatchFSM fsm;
+
+    zassert_equal(fsm.dispatch(GESTURE_PRESS), ACT_NONE, NULL);
+    zassert_equal(fsm.state, SW_IDLE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_SHORT), ACT_START | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_SHORT), ACT_LAP | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+
+    // the holds light the LEDs, the release decides
+    zassert_equal(fsm.dispatch(GESTURE_HOLD_2S), ACT_LED0_ON, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_LONG), ACT_PAUSE | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_PAUSE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_SHORT), ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_PAUSE, "a short press does not resume");
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_LONG), ACT_RESUME | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+
+    zassert_equal(fsm.dispatch(GESTURE_HOLD_2S), ACT_LED0_ON, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_HOLD_4S), ACT_LED1_ON, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_VERY_LONG), ACT_LEDS_ON, NULL);
+    zassert_equal(fsm.state, SW_RESET, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_RELEASE_SHORT), ACT_START | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+}
+
+/**
+ * @brief each key does its one thing and nothing in the states it does not apply to
+ * 
+ */
+void test_fsm_keys(void){
+    StopwatchFSM fsm;
+
+    zassert_equal(fsm.dispatch(GESTURE_KEY_LAP), ACT_NONE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_PAUSE), ACT_NONE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_RESET), ACT_NONE, NULL);
+    zassert_equal(fsm.state, SW_IDLE, NULL);
+
+    zassert_equal(fsm.dispatch(GESTURE_KEY_START), ACT_START | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_START), ACT_NONE, "start while running does nothing");
+    zassert_equal(fsm.dispatch(GESTURE_KEY_LAP), ACT_LAP | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_PAUSE), ACT_PAUSE | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_PAUSE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_LAP), ACT_NONE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_PAUSE), ACT_NONE, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_START), ACT_RESUME | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_RESET), ACT_LEDS_ON, NULL);
+    zassert_equal(fsm.state, SW_RESET, NULL);
+    zassert_equal(fsm.dispatch(GESTURE_KEY_START), ACT_START | ACT_LEDS_OFF, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+}
+
+/**
+ * @brief unknown gestures are ignored, a restored session comes back paused or idle
+ * 
+ */
+void test_fsm_bounds_and_restore(void){
+    StopwatchFSM fsm;
+
+    fsm.state = SW_RUN;
+    zassert_equal(fsm.dispatch(GESTURE_NUM_TYPES), ACT_NONE, NULL);
+    zassert_equal(fsm.dispatch(0xff), ACT_NONE, NULL);
+    zassert_equal(fsm.state, SW_RUN, NULL);
+
+    fsm.restore(SW_RUN);
+    zassert_equal(fsm.state, SW_PAUSE, NULL);
+    fsm.restore(SW_PAUSE);
+    zassert_equal(fsm.state, SW_PAUSE, NULL);
+    fsm.restore(SW_RESET);
+    zassert_equal(fsm.state, SW_IDLE, NULL);
+    fsm.restore(0xff);
+    zassert_equal(fsm.state, SW_IDLE, NULL);
+
+    // every cell of the table leads somewhere valid, whatever the gesture
+    for(uint8_t state = 0; state < SW_NUM_STATES; state++){
+        for(uint8_t gesture = 0; gesture < GESTURE_NUM_TYPES; gesture++){
+            fsm.state = state;
+            fsm.dispatch(gesture);
+            zassert_true(fsm.state < SW_NUM_STATES, "state %u gesture %u", state, gesture);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * @file test_gesturechannel.cpp
+ * @brief GestureChannel sequence numbers and drop accounting, with CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE=4
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include <ztest.h>
+#include <gesturechannel.hpp>
+
+BUILD_ASSERT(CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE == 4, "the tests expect a ring of 4 events");
+
+
+/* the event number goes in queued, the channel does not look at it */
+static void publish_numbered(GestureChannel* channel, uint32_t from, uint32_t to){
+    for(uint32_t i = from; i < to; i++){
+        struct gesture_event event = {};
+
+        event.type = i % GESTURE_NUM_TYPES;
+        event.queued = i;
+        channel->publish(event);
+    }
+}
+
+/**
+ * @brief every subscriber reads every event, in order, at its own pace
+ * 
+ */
+void test_channel_in_order(void){
+    GestureChannel channel{};       // zeroed like a static one, the spinlock included
+    struct gesture_subscriber a, b;
+    struct gesture_event event;
+
+    zassert_equal(channel.subscribe(&a), 0, NULL);
+    zassert_equal(channel.subscribe(&b), 0, NULL);
+    zassert_equal(channel.read(&a, &event), -EAGAIN, NULL);
+    zassert_equal(k_sem_count_get(&a.available), 0, NULL);
+
+    publish_numbered(&channel, 0, 3);
+    zassert_equal(k_sem_count_get(&a.available), 1, NULL);
+    zassert_equal(k_sem_count_get(&b.available), 1, NULL);
+
+    for(uint32_t i = 0; i < 3; i++){
+        zassert_equal(channel.read(&a, &event), 0, NULL);
+        zassert_equal(event.queued, i, NULL);
+        zassert_equal(event.type, i % GESTURE_NUM_TYPES, NULL);
+    }
+    zassert_equal(channel.read(&a, &event), -EAGAIN, NULL);
+    zassert_equal(a.next, 3, NULL);
+    zassert_equal(a.dropped, 0, NULL);
+
+    // b has not read yet and still gets all three
+    zassert_equal(channel.read(&b, &event), 0, NULL);
+    zassert_equal(event.queued, 0, NULL);
+    zassert_equal(b.next, 1, NULL);
+}
+
+/**
+ * @brief a subscriber that falls behind loses the oldest events and counts them
+ * 
+ */
+void test_channel_drops(void){
+    GestureChannel channel{};
+    struct gesture_subscriber a;
+    struct gesture_event event;
+
+    channel.subscribe(&a);
+    publish_numbered(&channel, 0, 10);
+
+    for(uint32_t i = 10 - CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE; i < 10; i++){
+        zassert_equal(channel.read(&a, &event), 0, NULL);
+        zassert_equal(event.queued, i, NULL);
+        zassert_equal(a.dropped, 10 - CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE, NULL);
+    }
+    zassert_equal(channel.read(&a, &event), -EAGAIN, NULL);
+
+    // exactly a ring full behind loses nothing
+    publish_numbered(&channel, 10, 10 + CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE);
+    for(uint32_t i = 10; i < 10 + CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE; i++){
+        zassert_equal(channel.read(&a, &event), 0, NULL);
+        zassert_equal(event.queued, i, NULL);
+    }
+    zassert_equal(a.dropped, 10 - CONFIG_STOPWATCH_EVENT_CHANNEL_SIZE, NULL);
+}
+
+/**
+ * @brief a new subscriber starts at the head, not with the events before it
+ * 
+ */
+void test_channel_late_subscriber(void){
+    GestureChannel channel{};
+    struct gesture_subscriber late;
+    struct gesture_event event;
+
+    publish_numbered(&channel, 0, 6);
+    zassert_equal(channel.subscribe(&late), 0, NULL);
+    zassert_equal(late.next, 6, NULL);
+    zassert_equal(channel.read(&late, &event), -EAGAIN, NULL);
+    zassert_equal(late.dropped, 0, NULL);
+
+    publish_numbered(&channel, 6, 7);
+    zassert_equal(channel.read(&late, &event), 0, NULL);
+    zassert_equal(event.queued, 6, NULL);
+}
+
+/**
+ * @brief GESTURE_MAX_SUBSCRIBERS and no more
+ * 
+ */
+void test_channel_subscriber_limit(void){
+    GestureChannel channel{};
+    struct gesture_subscriber subscribers[GESTURE_MAX_SUBSCRIBERS + 1];
+
+    for(uint8_t i = 0; i < GESTURE_MAX_SUBSCRIBERS; i++){
+        zassert_equal(channel.subscribe(&subscribers[i]), 0, NULL);
+    }
+    zassert_equal(channel.subscribe(&subscribers[GESTURE_MAX_SUBSCRIBERS]), -ENOMEM, NULL);
+}
+
+static atomic_t work_runs;
+
+static void count_work(struct k_work* work){
+    atomic_inc(&work_runs);
+}
+
+/**
+ * @brief a subscriber on a workqueue gets its work submitted instead of the semaphore
+ * 
+ */
+void test_channel_work(void){
+    GestureChannel channel{};
+    struct gesture_subscriber a;
+    struct gesture_event event;
+    struct k_work work;
+
+    atomic_set(&work_runs, 0);
+    k_work_init(&work, count_work);
+    zassert_equal(channel.subscribe(&a, &k_sys_work_q, &work), 0, NULL);
+
+    publish_numbered(&channel, 0, 2);
+    k_msleep(10);
+    zassert_true(atomic_get(&work_runs) >= 1, NULL);
+    zassert_equal(k_sem_count_get(&a.available), 0, NULL);
+    zassert_equal(channel.read(&a, &event), 0, NULL);
+    zassert_equal(channel.read(&a, &event), 0, NULL);
+    zassert_equal(channel.read(&a, &event), -EAGAIN, NULL);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file test_laphistory.cpp
+ * @brief LapHistory statistics and ring, with CONFIG_STOPWATCH_LAP_HISTORY_SIZE=4
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include <ztest.h>
+#include <laphistory.hpp>
+
+BUILD_ASSERT(CONFIG_STOPWATCH_LAP_HISTORY_SIZE == 4, "the tests expect a ring of 4 laps");
+
+static LapHistory history;
+
+
+/**
+ * @brief best, worst, delta to the best, and Welford's mean and sample variance
+ * 
+ */
+void test_laphistory_stats(void){
+    const int64_t durations[] = {100, 80, 120, 90, 110};
+    const int64_t deltas[] = {0, -20, 40, 10, 30};
+
+    history.clear();
+    zassert_equal(history.count(), 0, NULL);
+    zassert_is_null(history.get(0), NULL);
+
+    for(uint8_t i = 0; i < ARRAY_SIZE(durations); i++){
+        const struct lap_record& lap = history.add(durations[i]);
+
+        zassert_equal(lap.number, i + 1, NULL);
+        zassert_equal(lap.duration, durations[i], NULL);
+        zassert_equal(lap.delta_best, deltas[i], "lap %u", i + 1);
+        if(i == 0){
+            zassert_equal(history.variance(), 0, "fewer than two laps");
+        }
+    }
+
+    zassert_equal(history.count(), 5, NULL);
+    zassert_equal(history.best(), 80, NULL);
+    zassert_equal(history.worst(), 120, NULL);
+    zassert_equal(history.mean(), 100, NULL);
+    // squared differences 0 + 400 + 400 + 100 + 100 over 5 - 1 laps
+    zassert_equal(history.variance(), 250, NULL);
+}
+
+/**
+ * @brief laps of an hour in ticks, a spread of one tick still shows
+ * 
+ */
+void test_laphistory_long_laps(void){
+    const int64_t hour = k_ms_to_ticks_ceil64(3600000);
+
+    history.clear();
+    history.add(hour - 1);
+    history.add(hour);
+    history.add(hour + 1);
+
+    zassert_equal(history.mean(), hour, NULL);
+    zassert_equal(history.variance(), 1, NULL);
+    zassert_equal(history.best(), hour - 1, NULL);
+    zassert_equal(history.worst(), hour + 1, NULL);
+}
+
+/**
+ * @brief the ring keeps the newest laps, the statistics keep all of them
+ * 
+ */
+void test_laphistory_ring_wrap(void){
+    history.clear();
+    for(int64_t i = 1; i <= 6; i++){
+        history.add(i * 10);
+    }
+
+    zassert_equal(history.count(), 6, NULL);
+    zassert_equal(history.stored(), CONFIG_STOPWATCH_LAP_HISTORY_SIZE, NULL);
+    for(uint32_t age = 0; age < CONFIG_STOPWATCH_LAP_HISTORY_SIZE; age++){
+        const struct lap_record* lap = history.get(age);
+
+        zassert_not_null(lap, "age %u", age);
+        zassert_equal(lap->number, 6 - age, NULL);
+        zassert_equal(lap->duration, (6 - age) * 10, NULL);
+    }
+    zassert_is_null(history.get(CONFIG_STOPWATCH_LAP_HISTORY_SIZE), NULL);
+
+    // laps 1 and 2 are gone from the ring, not from the statistics
+    zassert_equal(history.best(), 10, NULL);
+    zassert_equal(history.worst(), 60, NULL);
+    zassert_equal(history.mean(), 35, NULL);
+
+    history.clear();
+    zassert_equal(history.count(), 0, NULL);
+    zassert_equal(history.stored(), 0, NULL);
+    zassert_is_null(history.get(0), NULL);
+    zassert_equal(history.add(70).number, 1, "a cleared history starts at lap 1");
+    zassert_equal(history.best(), 70, NULL);
+}
@@ -0,0 +1,155 @@
+/**
+ * @file test_laplog.cpp
+ * @brief Lap log on the flash simulator, with batches of 4 and 4 batches kept
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <laplog.hpp>
+#include <stopwatchfsm.hpp>
+
+BUILD_ASSERT(CONFIG_STOPWATCH_LAPLOG_BATCH == 4 && CONFIG_STOPWATCH_LAPLOG_MAX_BATCHES == 4,
+             "the tests expect batches of 4 laps, 4 batches kept");
+
+struct replayed{
+    uint32_t count;
+    uint32_t numbers[32];
+    int64_t durations[32];
+};
+
+static struct laplog_session session;
+static struct replayed laps;
+
+
+static int64_t lap_duration(uint32_t number){
+    return k_ms_to_ticks_ceil64(1000 + number);
+}
+
+static void collect_lap(uint32_t number, int64_t duration, void* user_data){
+    struct replayed* out = (struct replayed*)user_data;
+
+    if(out->count < ARRAY_SIZE(out->numbers)){
+        out->numbers[out->count] = number;
+        out->durations[out->count] = duration;
+    }
+    out->count++;
+}
+
+/* the commits run on the system workqueue, let them */
+static void laplog_wait(void){
+    k_msleep(20);
+}
+
+static void add_laps(uint32_t from, uint32_t to){
+    for(uint32_t number = from; number <= to; number++){
+        session.elapsed += lap_duration(number);
+        session.since_last_lap = 0;
+        session.num_laps = number;
+        laplog_add_lap(number, lap_duration(number), &session);
+        laplog_wait();
+    }
+}
+
+/* what a reset does to the log: mount again and replay what the flash holds */
+static int reboot_and_recover(struct laplog_session* restored){
+    memset(&laps, 0, sizeof(laps));
+    zassert_equal(laplog_init(), 0, NULL);
+    return laplog_recover(restored, collect_lap, &laps);
+}
+
+static void assert_laps(uint32_t first, uint32_t last){
+    zassert_equal(laps.count, last - first + 1, NULL);
+    for(uint32_t i = 0; i < laps.count; i++){
+        zassert_equal(laps.numbers[i], first + i, "lap %u", i);
+        zassert_equal(laps.durations[i], lap_duration(first + i), "lap %u", i);
+    }
+}
+
+/**
+ * @brief a full batch and a partial one saved with the session come back in order
+ * 
+ */
+void test_laplog_replay(void){
+    struct laplog_session restored;
+
+    // the simulated flash outlives the process, start from an empty log
+    zassert_equal(laplog_init(), 0, NULL);
+    laplog_clear();
+    laplog_wait();
+
+    memset(&session, 0, sizeof(session));
+    session.state = SW_RUN;
+    add_laps(1, 6);
+    session.state = SW_PAUSE;
+    session.since_last_lap = k_ms_to_ticks_ceil64(500);
+    laplog_save_session(&session);
+    laplog_wait();
+
+    zassert_equal(reboot_and_recover(&restored), 6, NULL);
+    assert_laps(1, 6);
+    zassert_equal(restored.state, SW_PAUSE, NULL);
+    zassert_equal(restored.num_laps, 6, NULL);
+    zassert_equal(restored.elapsed, session.elapsed, NULL);
+    zassert_equal(restored.since_last_lap, session.since_last_lap, NULL);
+}
+
+/**
+ * @brief laps after a recovery go into the partial batch, they do not overwrite it
+ * 
+ */
+void test_laplog_partial_batch_takeover(void){
+    struct laplog_session restored;
+
+    // continues from the log test_laplog_replay() left, laps 5 and 6 are in the partial batch
+    session.state = SW_RUN;
+    add_laps(7, 7);
+    laplog_save_session(&session);
+    laplog_wait();
+
+    zassert_equal(reboot_and_recover(&restored), 7, NULL);
+    assert_laps(1, 7);
+
+    // lap 8 fills the batch, taken over a second time
+    add_laps(8, 8);
+    zassert_equal(reboot_and_recover(&restored), 8, NULL);
+    assert_laps(1, 8);
+    zassert_equal(restored.num_laps, 8, NULL);
+}
+
+/**
+ * @brief only the newest batches are kept, the one being filled shares its id with the oldest
+ * 
+ */
+void test_laplog_ring_wrap(void){
+    struct laplog_session restored;
+
+    laplog_clear();
+    laplog_wait();
+    memset(&session, 0, sizeof(session));
+    session.state = SW_RUN;
+    add_laps(1, 6 * CONFIG_STOPWATCH_LAPLOG_BATCH + 2);
+    laplog_save_session(&session);
+    laplog_wait();
+
+    // batches 3, 4 and 5 are full, batch 6 holds laps 25 and 26
+    zassert_equal(reboot_and_recover(&restored), 3 * CONFIG_STOPWATCH_LAPLOG_BATCH + 2, NULL);
+    assert_laps(3 * CONFIG_STOPWATCH_LAPLOG_BATCH + 1, 6 * CONFIG_STOPWATCH_LAPLOG_BATCH + 2);
+    zassert_equal(restored.num_laps, 6 * CONFIG_STOPWATCH_LAPLOG_BATCH + 2, NULL);
+}
+
+/**
+ * @brief a cleared log replays nothing, even with the batches of the old one still in flash
+ * 
+ */
+void test_laplog_clear(void){
+    struct laplog_session restored;
+
+    laplog_clear();
+    laplog_wait();
+
+    zassert_equal(reboot_and_recover(&restored), 0, NULL);
+    zassert_equal(restored.num_laps, 0, NULL);
+}
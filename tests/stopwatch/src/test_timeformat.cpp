@@ -0,0 +1,68 @@
+/**
+ * @file test_timeformat.cpp
+ * @brief TimeCounter against timefmt_ms(), over more steps than the static_asserts cover
+ * @version 0.1
+ * 
+ * 
+ */
+
+#include <ztest.h>
+#include <timeformat.hpp>
+
+
+static void assert_counter_at(const TimeCounter& counter, uint32_t centis){
+    TimeCounter fresh;
+    char out[TIMEFMT_LEN];
+    char expected[TIMEFMT_LEN];
+
+    fresh.set_centis(centis);
+    counter.format(out);
+    fresh.format(expected);
+    zassert_mem_equal(out, expected, TIMEFMT_LEN, "at %u centis", centis);
+    zassert_equal(counter.total_centis, centis, NULL);
+}
+
+/**
+ * @brief steps of a frame or two, across minute and hour wraps, match formatting from scratch
+ * 
+ */
+void test_timecounter_advance(void){
+    TimeCounter counter;
+    char out[TIMEFMT_LEN];
+    uint32_t centis = 0;
+    uint32_t step = 1;
+
+    counter.set_ms(0);
+    while(centis < 2 * 360000){
+        centis += step;
+        step = (step % 7) + 1;      // 1..7 centis, the frames are not evenly spaced
+        counter.advance_to(centis);
+        assert_counter_at(counter, centis);
+    }
+
+    counter.set_ms(3599990);
+    counter.advance_to(360003);
+    counter.format(out);
+    zassert_mem_equal(out, "00:00:03", TIMEFMT_LEN, NULL);
+
+    // backwards and a jump of a minute or more start over from the value
+    counter.advance_to(100);
+    assert_counter_at(counter, 100);
+    counter.advance_to(100 + 6000);
+    assert_counter_at(counter, 100 + 6000);
+}
+
+/**
+ * @brief the centisecond count keeps going where milliseconds would have wrapped
+ * 
+ */
+void test_timecounter_past_ms_wrap(void){
+    const uint32_t ms_wrap_centis = UINT32_MAX / 10;
+    TimeCounter counter;
+
+    counter.set_centis(ms_wrap_centis - 50);
+    for(uint32_t centis = ms_wrap_centis - 50; centis < ms_wrap_centis + 500; centis += 3){
+        counter.advance_to(centis);
+        assert_counter_at(counter, centis);
+    }
+}